@@ -0,0 +1,96 @@
+/*-
+ * $Copyright$
+ */
+
+#include "DeviceWatchdog.hpp"
+#include "LibUsb.hpp"
+
+#include <libusb-1.0/libusb.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+std::atomic<bool>       DeviceWatchdog::m_dead(false);
+std::mutex              DeviceWatchdog::m_mutex;
+std::string             DeviceWatchdog::m_diagnosis;
+std::atomic<unsigned>   DeviceWatchdog::m_consecutiveTimeouts(0);
+std::atomic<uint64_t>   DeviceWatchdog::m_transferErrors(0);
+std::atomic<uint32_t>   DeviceWatchdog::m_samples[2][DeviceWatchdog::m_numSamples];
+std::atomic<uint64_t>   DeviceWatchdog::m_sampleCount[2];
+
+std::string
+DeviceWatchdog::diagnosis(void) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return m_diagnosis;
+}
+
+void
+DeviceWatchdog::declareDead(const std::string &p_diagnosis) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (dead()) {
+            return;
+        }
+
+        m_diagnosis = "USB Device under Test is unresponsive: " + p_diagnosis;
+        m_dead.store(true, std::memory_order_release);
+    }
+
+    std::cerr << "[ WATCHDOG ] " << diagnosis() << std::endl
+      << "[ WATCHDOG ] Cancelling in-flight Transfers and skipping all remaining Tests that need the Device." << std::endl;
+
+    LibUsb::cancelTransfers();
+}
+
+void
+DeviceWatchdog::transfer(UsbMetrics::Transfer p_type, int p_status, std::chrono::nanoseconds p_latency) {
+    if ((p_status < 0) && (p_status != LIBUSB_ERROR_PIPE)) {
+        m_transferErrors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (p_status == LIBUSB_ERROR_NO_DEVICE) {
+        declareDead("Device is gone (LIBUSB_ERROR_NO_DEVICE).");
+    } else if (p_status == LIBUSB_ERROR_TIMEOUT) {
+        const unsigned timeouts = m_consecutiveTimeouts.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        if (timeouts >= m_maxConsecutiveTimeouts) {
+            declareDead(std::to_string(timeouts) + " Transfers in a row timed out.");
+        }
+    } else {
+        /* Any other Outcome, including a STALL, means the Device is still responding */
+        m_consecutiveTimeouts.store(0, std::memory_order_relaxed);
+
+        if (p_status >= 0) {
+            const unsigned type = static_cast<unsigned>(p_type);
+            const uint64_t idx = m_sampleCount[type].fetch_add(1, std::memory_order_relaxed);
+            const uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(p_latency).count();
+
+            m_samples[type][idx % m_numSamples].store(std::min<uint64_t>(us, UINT32_MAX), std::memory_order_relaxed);
+        }
+    }
+}
+
+unsigned
+DeviceWatchdog::timeout(UsbMetrics::Transfer p_type, unsigned p_ceiling) {
+    const unsigned type = static_cast<unsigned>(p_type);
+    const size_t count = std::min<uint64_t>(m_sampleCount[type].load(std::memory_order_relaxed), m_numSamples);
+
+    if (count < m_minSamples) {
+        return p_ceiling;
+    }
+
+    std::vector<uint32_t> samples(count);
+    for (size_t idx = 0; idx < count; idx++) {
+        samples[idx] = m_samples[type][idx].load(std::memory_order_relaxed);
+    }
+
+    std::vector<uint32_t>::iterator p99 = samples.begin() + ((count * 99) / 100);
+    std::nth_element(samples.begin(), p99, samples.end());
+
+    const uint64_t timeout = ((static_cast<uint64_t>(*p99) * m_timeoutFactor) + 999) / 1000;
+
+    return std::min<uint64_t>(std::max<uint64_t>(timeout, m_minTimeout), p_ceiling);
+}
@@ -0,0 +1,75 @@
+/*-
+ * $Copyright$
+ */
+
+#ifndef DEVICE_WATCHDOG_HPP_E4C71B0D_5A28_4F93_B6E2_0D8A39F1C765
+#define DEVICE_WATCHDOG_HPP_E4C71B0D_5A28_4F93_B6E2_0D8A39F1C765
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "UsbMetrics.hpp"
+
+/*
+ * Detects a hung or disconnected USB Device so the remaining Tests do not each
+ * wait out their Transfer Timeouts.
+ *
+ * Every Transfer issued through LibUsb is reported here. The Device is declared
+ * dead when it disconnects, after m_maxConsecutiveTimeouts Transfers in a row
+ * timed out, or when it does not answer a GET_STATUS Health Check after a Test
+ * with failed Transfers (see UsbDeviceTest). From then on:
+ *
+ *  - the in-flight asynchronous Transfers are cancelled. Synchronous Transfers
+ *    cannot be cancelled; they are bounded by their (adaptive) Timeout,
+ *  - further Transfers fail immediately with LIBUSB_ERROR_NO_DEVICE,
+ *  - Fixtures that need the Device skip their Tests with diagnosis().
+ *
+ * The Watchdog also keeps the latest Latencies of successful Transfers and
+ * derives Timeouts from them, so a Transfer to a hung Device fails after a
+ * multiple of the Device's usual Latency instead of a fixed worst-case Timeout.
+ */
+class DeviceWatchdog {
+public:
+    static constexpr unsigned   m_maxConsecutiveTimeouts    = 3;
+    static constexpr unsigned   m_healthCheckTimeout        = 100;     /* ms */
+
+    /* Adaptive Timeouts: p99 of the last m_numSamples Latencies times m_timeoutFactor, at least m_minTimeout ms */
+    static constexpr size_t     m_numSamples                = 1024;
+    static constexpr size_t     m_minSamples                = 64;
+    static constexpr unsigned   m_timeoutFactor             = 8;
+    static constexpr unsigned   m_minTimeout                = 50;      /* ms */
+
+    static bool         dead(void) { return m_dead.load(std::memory_order_acquire); }
+    static std::string  diagnosis(void);
+
+    /* Only the first Call has an Effect, so there is a single Diagnosis */
+    static void         declareDead(const std::string &p_diagnosis);
+
+    static unsigned     consecutiveTimeouts(void) { return m_consecutiveTimeouts.load(std::memory_order_relaxed); }
+
+    /* Number of Transfers so far that failed with an Error other than a STALL */
+    static uint64_t     transferErrors(void) { return m_transferErrors.load(std::memory_order_relaxed); }
+
+    /* p_status is the libusb Return Code */
+    static void         transfer(UsbMetrics::Transfer p_type, int p_status, std::chrono::nanoseconds p_latency);
+
+    /* Timeout in ms for the next Transfer of p_type, never more than p_ceiling */
+    static unsigned     timeout(UsbMetrics::Transfer p_type, unsigned p_ceiling);
+
+private:
+    static std::atomic<bool>        m_dead;
+    static std::mutex               m_mutex;
+    static std::string              m_diagnosis;
+    static std::atomic<unsigned>    m_consecutiveTimeouts;
+    static std::atomic<uint64_t>    m_transferErrors;
+
+    /* Ring Buffers of Latencies in Microseconds, per Transfer Type */
+    static std::atomic<uint32_t>    m_samples[2][m_numSamples];
+    static std::atomic<uint64_t>    m_sampleCount[2];
+};
+
+#endif /* DEVICE_WATCHDOG_HPP_E4C71B0D_5A28_4F93_B6E2_0D8A39F1C765 */
@@ -0,0 +1,135 @@
+/*-
+ * $Copyright$
+ */
+
+#include "FixturePhases.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+std::vector<LatencyStatistics> FixturePhases::m_suite;
+
+const char *
+FixturePhases::name(Phase p_phase) {
+    switch (p_phase) {
+    case Phase::Init:               return "init";
+    case Phase::DeviceScan:         return "device_scan";
+    case Phase::Open:               return "open";
+    case Phase::SetConfiguration:   return "set_configuration";
+    case Phase::DescriptorFetch:    return "descriptor_fetch";
+    case Phase::DescriptorParse:    return "descriptor_parse";
+    case Phase::Claim:              return "claim";
+    case Phase::Body:               return "body";
+    case Phase::HealthCheck:        return "health_check";
+    case Phase::Release:            return "release";
+    case Phase::DescriptorFree:     return "descriptor_free";
+    case Phase::Deconfigure:        return "deconfigure";
+    case Phase::Close:              return "close";
+    case Phase::Exit:               return "exit";
+    }
+
+    return "unknown";
+}
+
+FixturePhases::FixturePhases(void) : m_lastEnd(Clock::now()) {
+    std::fill(m_durations, m_durations + m_numPhases, Duration::zero());
+    std::fill(m_ran, m_ran + m_numPhases, false);
+}
+
+void
+FixturePhases::add(Phase p_phase, const Clock::time_point &p_start, const Clock::time_point &p_end) {
+    const size_t idx = static_cast<size_t>(p_phase);
+
+    /* Some Phases, e.g. the Device Scan, are made up of several Steps */
+    m_durations[idx] += std::chrono::duration_cast<Duration>(p_end - p_start);
+    m_ran[idx] = true;
+    m_lastEnd = p_end;
+}
+
+void
+FixturePhases::finish(void) const {
+    Duration setUp = Duration::zero(), tearDown = Duration::zero();
+
+    if (m_suite.size() != m_numPhases) {
+        beginSuite();
+    }
+
+    for (size_t idx = 0; idx < m_numPhases; idx++) {
+        if (!m_ran[idx]) {
+            continue;
+        }
+
+        const Phase phase = static_cast<Phase>(idx);
+        ::testing::Test::RecordProperty(std::string("phase.") + name(phase) + "_us",
+          LatencyStatistics::formatMicroseconds(m_durations[idx]));
+
+        if (phase < Phase::Body) {
+            setUp += m_durations[idx];
+        } else if (phase > Phase::Body) {
+            tearDown += m_durations[idx];
+        }
+
+        m_suite[idx].add(m_durations[idx]);
+    }
+
+    ::testing::Test::RecordProperty("phase.setup_us", LatencyStatistics::formatMicroseconds(setUp));
+    ::testing::Test::RecordProperty("phase.teardown_us", LatencyStatistics::formatMicroseconds(tearDown));
+}
+
+void
+FixturePhases::beginSuite(void) {
+    m_suite.clear();
+    m_suite.reserve(m_numPhases);
+
+    for (size_t idx = 0; idx < m_numPhases; idx++) {
+        m_suite.emplace_back(std::string("phase.") + name(static_cast<Phase>(idx)));
+    }
+}
+
+void
+FixturePhases::endSuite(std::ostream &p_os, size_t p_top) {
+    std::vector<const LatencyStatistics *> phases;
+    Duration total = Duration::zero();
+
+    for (const LatencyStatistics &stats : m_suite) {
+        if (stats.count() > 0) {
+            phases.push_back(&stats);
+            total += stats.total();
+        }
+    }
+
+    std::sort(phases.begin(), phases.end(), [](const LatencyStatistics *a, const LatencyStatistics *b) {
+        return a->total() > b->total();
+    });
+
+    const ::testing::TestSuite * const suite = ::testing::UnitTest::GetInstance()->current_test_suite();
+    p_os << "[ PhaseStat] Most expensive Fixture Phases of " << ((suite != nullptr) ? suite->name() : "Test Suite")
+      << " (" << LatencyStatistics::formatMicroseconds(total) << "us total):" << std::endl;
+
+    /* Records on the Test Suite when called from TearDownTestSuite() */
+    std::ostringstream ranking;
+    for (size_t idx = 0; idx < phases.size(); idx++) {
+        const LatencyStatistics &stats = *phases[idx];
+        const double share = (total.count() > 0) ? (100.0 * stats.total().count() / total.count()) : 0.0;
+
+        ::testing::Test::RecordProperty(stats.name() + ".total_us", LatencyStatistics::formatMicroseconds(stats.total()));
+        ::testing::Test::RecordProperty(stats.name() + ".mean_us", LatencyStatistics::formatMicroseconds(stats.mean()));
+
+        if (idx < p_top) {
+            ranking << ((idx > 0) ? "," : "") << stats.name().substr(stats.name().find('.') + 1);
+
+            std::ostringstream line;
+            line << "[ PhaseStat]   #" << (idx + 1) << " "
+              << std::fixed << std::setprecision(1) << std::setw(5) << share << "% " << stats;
+            p_os << line.str() << std::endl;
+        }
+    }
+    ::testing::Test::RecordProperty("phase.ranking", ranking.str());
+    ::testing::Test::RecordProperty("phase.total_us", LatencyStatistics::formatMicroseconds(total));
+
+    m_suite.clear();
+}
@@ -0,0 +1,89 @@
+/*-
+ * $Copyright$
+ */
+
+#ifndef FIXTURE_PHASES_HPP_2A9E6D41_C3B7_4F08_9D5E_1B8F70A4C2E6
+#define FIXTURE_PHASES_HPP_2A9E6D41_C3B7_4F08_9D5E_1B8F70A4C2E6
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+#include "LatencyStatistics.hpp"
+
+/*
+ * Wall-Time spent in the individual Phases of a Test Fixture's Set-up, Test
+ * Body and Tear-down.
+ *
+ * Each Test records the Phases it ran as "phase.<name>_us" Properties in the
+ * gtest XML/JSON Output. All Tests of a Test Suite are rolled up into one
+ * Distribution per Phase, which is recorded on the Test Suite and printed
+ * with the most expensive Phases first.
+ */
+class FixturePhases {
+public:
+    typedef LatencyStatistics::Clock    Clock;
+    typedef LatencyStatistics::Duration Duration;
+
+    enum class Phase {
+        Init,
+        DeviceScan,
+        Open,
+        SetConfiguration,
+        DescriptorFetch,
+        DescriptorParse,
+        Claim,
+        Body,
+        HealthCheck,
+        Release,
+        DescriptorFree,
+        Deconfigure,
+        Close,
+        Exit
+    };
+
+    static constexpr size_t m_numPhases = static_cast<size_t>(Phase::Exit) + 1;
+
+    static const char * name(Phase p_phase);
+
+    /* Adds the Time from Construction to Destruction to a Phase; works with early Returns from ASSERT_*() */
+    class Scope {
+        FixturePhases &     m_phases;
+        const Phase         m_phase;
+        const Clock::time_point m_start;
+
+    public:
+        Scope(FixturePhases &p_phases, Phase p_phase)
+          : m_phases(p_phases), m_phase(p_phase), m_start(Clock::now()) {
+
+        }
+
+        ~Scope() {
+            m_phases.add(m_phase, m_start, Clock::now());
+        }
+    };
+
+private:
+    Duration                m_durations[m_numPhases];
+    bool                    m_ran[m_numPhases];
+    Clock::time_point       m_lastEnd;
+
+    static std::vector<LatencyStatistics>   m_suite;
+
+public:
+    FixturePhases(void);
+
+    void add(Phase p_phase, const Clock::time_point &p_start, const Clock::time_point &p_end);
+
+    /* End of the most recently completed Phase, e.g. the Start of the Test Body after Set-up */
+    const Clock::time_point & lastEnd(void) const { return m_lastEnd; }
+
+    /* Records this Test's Phases as Properties and adds them to the Test Suite's Roll-up */
+    void finish(void) const;
+
+    /* Call from SetUpTestSuite() / TearDownTestSuite() */
+    static void beginSuite(void);
+    static void endSuite(std::ostream &p_os, size_t p_top = 5);
+};
+
+#endif /* FIXTURE_PHASES_HPP_2A9E6D41_C3B7_4F08_9D5E_1B8F70A4C2E6 */
@@ -0,0 +1,144 @@
+/*-
+ * $Copyright$
+ */
+
+#include "LatencyStatistics.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+std::string
+LatencyStatistics::formatMicroseconds(const Duration &p_duration) {
+    std::ostringstream os;
+
+    os << std::fixed << std::setprecision(1) << (p_duration.count() / 1000.0);
+
+    return os.str();
+}
+
+static LatencyStatistics::Duration
+quantileOfSorted(const std::vector<LatencyStatistics::Duration> &p_sorted, double p_quantile) {
+    if (p_sorted.empty()) {
+        return LatencyStatistics::Duration::zero();
+    }
+
+    p_quantile = std::min(1.0, std::max(0.0, p_quantile));
+
+    /* Nearest-rank Method */
+    size_t rank = static_cast<size_t>(std::ceil(p_quantile * p_sorted.size()));
+    return p_sorted[(rank > 0) ? (rank - 1) : 0];
+}
+
+LatencyStatistics::LatencyStatistics(const std::string &p_name)
+  : m_name(p_name)
+{
+
+}
+
+void
+LatencyStatistics::add(const Duration &p_sample) {
+    m_samples.push_back(p_sample);
+    m_sortedSamples.clear();
+}
+
+void
+LatencyStatistics::add(const LatencyStatistics &p_other) {
+    m_samples.insert(m_samples.end(), p_other.m_samples.begin(), p_other.m_samples.end());
+    m_sortedSamples.clear();
+}
+
+void
+LatencyStatistics::clear(void) {
+    m_samples.clear();
+    m_sortedSamples.clear();
+}
+
+const std::vector<LatencyStatistics::Duration> &
+LatencyStatistics::sorted(void) const {
+    if (m_sortedSamples.size() != m_samples.size()) {
+        m_sortedSamples = m_samples;
+        std::sort(m_sortedSamples.begin(), m_sortedSamples.end());
+    }
+
+    return m_sortedSamples;
+}
+
+LatencyStatistics::Duration
+LatencyStatistics::total(void) const {
+    Duration sum = Duration::zero();
+
+    for (const Duration &sample : m_samples) {
+        sum += sample;
+    }
+
+    return sum;
+}
+
+LatencyStatistics::Duration
+LatencyStatistics::mean(void) const {
+    if (m_samples.empty()) {
+        return Duration::zero();
+    }
+
+    return total() / m_samples.size();
+}
+
+LatencyStatistics::Duration
+LatencyStatistics::min(void) const {
+    return m_samples.empty() ? Duration::zero() : sorted().front();
+}
+
+LatencyStatistics::Duration
+LatencyStatistics::max(void) const {
+    return m_samples.empty() ? Duration::zero() : sorted().back();
+}
+
+LatencyStatistics::Duration
+LatencyStatistics::quantile(double p_quantile) const {
+    return quantileOfSorted(sorted(), p_quantile);
+}
+
+LatencyStatistics::Duration
+LatencyStatistics::quantile(double p_quantile, size_t p_first, size_t p_last) const {
+    p_last = std::min(p_last, m_samples.size());
+    if (p_first >= p_last) {
+        return Duration::zero();
+    }
+
+    std::vector<Duration> range(m_samples.begin() + p_first, m_samples.begin() + p_last);
+    std::sort(range.begin(), range.end());
+
+    return quantileOfSorted(range, p_quantile);
+}
+
+void
+LatencyStatistics::report(std::ostream &p_os) const {
+    p_os << m_name << ": n=" << count()
+      << " min=" << formatMicroseconds(min()) << "us"
+      << " mean=" << formatMicroseconds(mean()) << "us"
+      << " p50=" << formatMicroseconds(quantile(0.50)) << "us"
+      << " p90=" << formatMicroseconds(quantile(0.90)) << "us"
+      << " p99=" << formatMicroseconds(quantile(0.99)) << "us"
+      << " max=" << formatMicroseconds(max()) << "us";
+}
+
+void
+LatencyStatistics::recordProperties(void) const {
+    ::testing::Test::RecordProperty(m_name + ".count", std::to_string(count()));
+    ::testing::Test::RecordProperty(m_name + ".min_us", formatMicroseconds(min()));
+    ::testing::Test::RecordProperty(m_name + ".mean_us", formatMicroseconds(mean()));
+    ::testing::Test::RecordProperty(m_name + ".p50_us", formatMicroseconds(quantile(0.50)));
+    ::testing::Test::RecordProperty(m_name + ".p90_us", formatMicroseconds(quantile(0.90)));
+    ::testing::Test::RecordProperty(m_name + ".p99_us", formatMicroseconds(quantile(0.99)));
+    ::testing::Test::RecordProperty(m_name + ".max_us", formatMicroseconds(max()));
+}
+
+std::ostream &
+operator<<(std::ostream &p_os, const LatencyStatistics &p_stats) {
+    p_stats.report(p_os);
+    return p_os;
+}
@@ -0,0 +1,67 @@
+/*-
+ * $Copyright$
+ */
+
+#ifndef LATENCY_STATISTICS_HPP_5E1F3A7C_8B2D_4C96_A0E4_71D9B3C62F18
+#define LATENCY_STATISTICS_HPP_5E1F3A7C_8B2D_4C96_A0E4_71D9B3C62F18
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * Collects latency samples of a single benchmark step and reports their
+ * distribution. All samples are kept, so quantiles are exact.
+ */
+class LatencyStatistics {
+public:
+    typedef std::chrono::steady_clock   Clock;
+    typedef std::chrono::nanoseconds    Duration;
+
+private:
+    std::string                     m_name;
+    std::vector<Duration>           m_samples;          /* In order of arrival */
+    mutable std::vector<Duration>   m_sortedSamples;    /* Cache, rebuilt after add() */
+
+    const std::vector<Duration> & sorted(void) const;
+
+public:
+    explicit LatencyStatistics(const std::string &p_name);
+
+    const std::string & name(void) const { return m_name; }
+
+    void add(const Duration &p_sample);
+    /* Appends all samples of p_other, e.g. to merge per-thread statistics */
+    void add(const LatencyStatistics &p_other);
+    void clear(void);
+    void add(const Clock::time_point &p_start, const Clock::time_point &p_end) {
+        add(std::chrono::duration_cast<Duration>(p_end - p_start));
+    }
+
+    size_t      count(void) const { return m_samples.size(); }
+    Duration    total(void) const;
+    Duration    mean(void) const;
+    Duration    min(void) const;
+    Duration    max(void) const;
+
+    /* Returns the sample at quantile p_quantile, with 0.0 <= p_quantile <= 1.0 */
+    Duration    quantile(double p_quantile) const;
+
+    /* Same as quantile(), but only considers the samples in [p_first, p_last) */
+    Duration    quantile(double p_quantile, size_t p_first, size_t p_last) const;
+
+    /* Prints a single line summary of the distribution */
+    void        report(std::ostream &p_os) const;
+
+    /* Adds the distribution to the gtest XML/JSON Output of the current Test */
+    void        recordProperties(void) const;
+
+    /* Formats p_duration in Microseconds with one decimal, e.g. "12.3" */
+    static std::string formatMicroseconds(const Duration &p_duration);
+};
+
+std::ostream & operator<<(std::ostream &p_os, const LatencyStatistics &p_stats);
+
+#endif /* LATENCY_STATISTICS_HPP_5E1F3A7C_8B2D_4C96_A0E4_71D9B3C62F18 */
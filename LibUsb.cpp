@@ -0,0 +1,846 @@
+/*-
+ * $Copyright$
+ */
+
+#include "LibUsb.hpp"
+#include "DeviceWatchdog.hpp"
+#include "UsbMetrics.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+LibUsb::Mode                LibUsb::m_mode          = LibUsb::Mode::Passthrough;
+LibUsb::Timing              LibUsb::m_timing        = LibUsb::Timing::Fast;
+LibUsb::Clock::time_point   LibUsb::m_epoch;
+UsbCaptureWriter            LibUsb::m_writer;
+UsbCaptureReader            LibUsb::m_reader;
+std::mutex                  LibUsb::m_replayMutex;
+bool                        LibUsb::m_diverged      = false;
+libusb_device **            LibUsb::m_deviceList    = nullptr;
+ssize_t                     LibUsb::m_deviceCount   = 0;
+char                        LibUsb::m_replayContext;
+char                        LibUsb::m_replayHandle;
+char                        LibUsb::m_replayDevices[256];
+
+static const uint32_t       noDevice = 0xFFFFFFFF;
+
+/*******************************************************************************
+ * Mode Selection
+ ******************************************************************************/
+bool
+LibUsb::record(const std::string &p_path, uint32_t p_seed, std::string &p_error) {
+    if (!m_writer.open(p_path, p_seed)) {
+        p_error = "Cannot create Capture File '" + p_path + "': " + ::strerror(errno);
+        return false;
+    }
+
+    m_epoch = Clock::now();
+    m_mode = Mode::Record;
+
+    return true;
+}
+
+bool
+LibUsb::replay(const std::string &p_path, Timing p_timing, std::string &p_error) {
+    if (!m_reader.open(p_path, p_error)) {
+        return false;
+    }
+
+    m_timing = p_timing;
+    m_diverged = false;
+    m_mode = Mode::Replay;
+
+    return true;
+}
+
+bool
+LibUsb::finish(void) {
+    const bool complete = m_writer.close();
+
+    if (!complete) {
+        std::cerr << "Record: Cannot write the Capture File (" << m_writer.error() << ")." << std::endl;
+    }
+
+    m_reader.close();
+    m_mode = Mode::Passthrough;
+
+    return complete;
+}
+
+/*******************************************************************************
+ * Record / Replay Helpers
+ ******************************************************************************/
+uint32_t
+LibUsb::deviceIndex(libusb_device *p_device) {
+    if (m_mode == Mode::Replay) {
+        const char * const device = reinterpret_cast<const char *>(p_device);
+
+        if ((device >= m_replayDevices) && (device < (m_replayDevices + sizeof(m_replayDevices)))) {
+            return device - m_replayDevices;
+        }
+        return noDevice;
+    }
+
+    for (ssize_t idx = 0; (m_deviceList != nullptr) && (idx < m_deviceCount); idx++) {
+        if (m_deviceList[idx] == p_device) {
+            return idx;
+        }
+    }
+
+    return noDevice;
+}
+
+void
+LibUsb::capture(UsbCapture::Call p_call, const Clock::time_point &p_start, int p_status,
+  std::initializer_list<uint32_t> p_args, const void *p_data, size_t p_length)
+{
+    const Clock::time_point end = Clock::now();
+    UsbCapture::Record record {};
+
+    record.m_call = p_call;
+    record.m_status = p_status;
+    record.m_offset = std::chrono::duration_cast<std::chrono::nanoseconds>(p_start - m_epoch).count();
+    record.m_duration = std::min<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - p_start).count(), UINT32_MAX);
+    std::copy_n(p_args.begin(), std::min(p_args.size(), UsbCapture::m_numArgs), record.m_args);
+    record.m_length = p_length;
+    record.m_data = static_cast<const uint8_t *>(p_data);
+
+    if (!m_writer.write(record)) {
+        ADD_FAILURE() << "Record: Cannot write " << UsbCapture::name(p_call) << " to the Capture File ("
+          << m_writer.error() << "). Recording stopped.";
+    }
+}
+
+bool
+LibUsb::diverged(void) {
+    std::lock_guard<std::mutex> lock(m_replayMutex);
+
+    return m_diverged;
+}
+
+bool
+LibUsb::replayNext(UsbCapture::Call p_call, std::initializer_list<uint32_t> p_inputs, UsbCapture::Record &p_record) {
+    std::lock_guard<std::mutex> lock(m_replayMutex);
+
+    if (m_diverged) {
+        return false;
+    }
+
+    const size_t index = m_reader.index();
+    if (!m_reader.next(p_record)) {
+        m_diverged = true;
+        ADD_FAILURE() << "Replay: Capture ended before Record #" << index << " (" << UsbCapture::name(p_call) << ")."
+          << " All further libusb Calls fail.";
+        return false;
+    }
+
+    bool match = (p_record.m_call == p_call);
+    for (unsigned idx = 0; match && (idx < p_inputs.size()); idx++) {
+        match = (p_record.m_args[idx] == p_inputs.begin()[idx]);
+    }
+
+    if (!match) {
+        std::ostringstream inputs;
+        for (const uint32_t &input : p_inputs) {
+            inputs << ((&input == p_inputs.begin()) ? "" : ", ") << input;
+        }
+
+        m_diverged = true;
+        ADD_FAILURE() << "Replay: Record #" << index << " is " << UsbCapture::name(p_record.m_call)
+          << "(" << p_record.m_args[0] << ", " << p_record.m_args[1] << ", " << p_record.m_args[2] << ", " << p_record.m_args[3] << ")"
+          << " but the Test called " << UsbCapture::name(p_call) << "(" << inputs.str() << ")."
+          << " All further libusb Calls fail.";
+        return false;
+    }
+
+    return true;
+}
+
+void
+LibUsb::replayDelay(const UsbCapture::Record &p_record, const Clock::time_point &p_start) {
+    if (m_timing == Timing::Original) {
+        std::this_thread::sleep_until(p_start + std::chrono::nanoseconds(p_record.m_duration));
+    }
+}
+
+/*******************************************************************************
+ * libusb Calls
+ ******************************************************************************/
+int
+LibUsb::init(libusb_context **p_ctx) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+    int rc;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        return libusb_init(p_ctx);
+    case Mode::Record:
+        rc = libusb_init(p_ctx);
+        capture(UsbCapture::Call::Init, start, rc, {});
+        return rc;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::Init, {}, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        *p_ctx = (record.m_status == LIBUSB_SUCCESS) ? reinterpret_cast<libusb_context *>(&m_replayContext) : nullptr;
+        replayDelay(record, start);
+        return record.m_status;
+    }
+
+    return LIBUSB_ERROR_OTHER;
+}
+
+void
+LibUsb::exit(libusb_context *p_ctx) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        libusb_exit(p_ctx);
+        break;
+    case Mode::Record:
+        libusb_exit(p_ctx);
+        capture(UsbCapture::Call::Exit, start, 0, {});
+        break;
+    case Mode::Replay:
+        if (replayNext(UsbCapture::Call::Exit, {}, record)) {
+            replayDelay(record, start);
+        }
+        break;
+    }
+}
+
+int
+LibUsb::setOption(libusb_context *p_ctx, enum libusb_option p_option, int p_value) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+    int rc;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        return libusb_set_option(p_ctx, p_option, p_value);
+    case Mode::Record:
+        rc = libusb_set_option(p_ctx, p_option, p_value);
+        capture(UsbCapture::Call::SetOption, start, rc, { static_cast<uint32_t>(p_option), static_cast<uint32_t>(p_value) });
+        return rc;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::SetOption, { static_cast<uint32_t>(p_option), static_cast<uint32_t>(p_value) }, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        replayDelay(record, start);
+        return record.m_status;
+    }
+
+    return LIBUSB_ERROR_OTHER;
+}
+
+ssize_t
+LibUsb::getDeviceList(libusb_context *p_ctx, libusb_device ***p_list) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+    ssize_t cnt;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        return libusb_get_device_list(p_ctx, p_list);
+    case Mode::Record:
+        cnt = libusb_get_device_list(p_ctx, p_list);
+        m_deviceList = (cnt >= 0) ? *p_list : nullptr;
+        m_deviceCount = std::max<ssize_t>(cnt, 0);
+        capture(UsbCapture::Call::GetDeviceList, start, cnt, {});
+        return cnt;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::GetDeviceList, {}, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        cnt = record.m_status;
+        if (cnt >= 0) {
+            /* Devices beyond the Replay Handles are dropped from the List */
+            cnt = std::min<ssize_t>(cnt, sizeof(m_replayDevices));
+            *p_list = new libusb_device *[cnt + 1];
+            for (ssize_t idx = 0; idx < cnt; idx++) {
+                (*p_list)[idx] = reinterpret_cast<libusb_device *>(m_replayDevices + idx);
+            }
+            (*p_list)[cnt] = nullptr;
+        }
+        replayDelay(record, start);
+        return cnt;
+    }
+
+    return LIBUSB_ERROR_OTHER;
+}
+
+void
+LibUsb::freeDeviceList(libusb_device **p_list, int p_unrefDevices) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        libusb_free_device_list(p_list, p_unrefDevices);
+        break;
+    case Mode::Record:
+        libusb_free_device_list(p_list, p_unrefDevices);
+        if (p_list == m_deviceList) {
+            m_deviceList = nullptr;
+            m_deviceCount = 0;
+        }
+        capture(UsbCapture::Call::FreeDeviceList, start, 0, { static_cast<uint32_t>(p_unrefDevices) });
+        break;
+    case Mode::Replay:
+        delete[] p_list;
+        if (replayNext(UsbCapture::Call::FreeDeviceList, { static_cast<uint32_t>(p_unrefDevices) }, record)) {
+            replayDelay(record, start);
+        }
+        break;
+    }
+}
+
+libusb_device *
+LibUsb::refDevice(libusb_device *p_device) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+    libusb_device *device;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        return libusb_ref_device(p_device);
+    case Mode::Record:
+        device = libusb_ref_device(p_device);
+        capture(UsbCapture::Call::RefDevice, start, 0, { deviceIndex(p_device) });
+        return device;
+    case Mode::Replay:
+        if (replayNext(UsbCapture::Call::RefDevice, { deviceIndex(p_device) }, record)) {
+            replayDelay(record, start);
+        }
+        return p_device;
+    }
+
+    return p_device;
+}
+
+void
+LibUsb::unrefDevice(libusb_device *p_device) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        libusb_unref_device(p_device);
+        break;
+    case Mode::Record:
+        capture(UsbCapture::Call::UnrefDevice, start, 0, { deviceIndex(p_device) });
+        libusb_unref_device(p_device);
+        break;
+    case Mode::Replay:
+        if (replayNext(UsbCapture::Call::UnrefDevice, { deviceIndex(p_device) }, record)) {
+            replayDelay(record, start);
+        }
+        break;
+    }
+}
+
+int
+LibUsb::getDeviceDescriptor(libusb_device *p_device, struct libusb_device_descriptor *p_descriptor) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+    int rc;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        return libusb_get_device_descriptor(p_device, p_descriptor);
+    case Mode::Record:
+        rc = libusb_get_device_descriptor(p_device, p_descriptor);
+        capture(UsbCapture::Call::GetDeviceDescriptor, start, rc, { deviceIndex(p_device) },
+          p_descriptor, (rc == LIBUSB_SUCCESS) ? sizeof(*p_descriptor) : 0);
+        return rc;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::GetDeviceDescriptor, { deviceIndex(p_device) }, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        if (record.m_length == sizeof(*p_descriptor)) {
+            ::memcpy(p_descriptor, record.m_data, sizeof(*p_descriptor));
+        }
+        replayDelay(record, start);
+        return record.m_status;
+    }
+
+    return LIBUSB_ERROR_OTHER;
+}
+
+int
+LibUsb::getActiveConfigDescriptor(libusb_device *p_device, struct libusb_config_descriptor **p_config) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+    std::vector<uint8_t> buffer;
+    int rc;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        return libusb_get_active_config_descriptor(p_device, p_config);
+    case Mode::Record:
+        rc = libusb_get_active_config_descriptor(p_device, p_config);
+        if (rc == LIBUSB_SUCCESS) {
+            UsbCapture::serializeConfigDescriptor(**p_config, buffer);
+        }
+        capture(UsbCapture::Call::GetActiveConfigDescriptor, start, rc, { deviceIndex(p_device) }, buffer.data(), buffer.size());
+        return rc;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::GetActiveConfigDescriptor, { deviceIndex(p_device) }, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        if (record.m_status == LIBUSB_SUCCESS) {
+            *p_config = UsbCapture::deserializeConfigDescriptor(record.m_data, record.m_length);
+            if (*p_config == nullptr) {
+                ADD_FAILURE() << "Replay: Configuration Descriptor in Capture is truncated.";
+                return LIBUSB_ERROR_OTHER;
+            }
+        }
+        replayDelay(record, start);
+        return record.m_status;
+    }
+
+    return LIBUSB_ERROR_OTHER;
+}
+
+void
+LibUsb::freeConfigDescriptor(struct libusb_config_descriptor *p_config) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        libusb_free_config_descriptor(p_config);
+        break;
+    case Mode::Record:
+        libusb_free_config_descriptor(p_config);
+        capture(UsbCapture::Call::FreeConfigDescriptor, start, 0, {});
+        break;
+    case Mode::Replay:
+        UsbCapture::freeConfigDescriptor(p_config);
+        if (replayNext(UsbCapture::Call::FreeConfigDescriptor, {}, record)) {
+            replayDelay(record, start);
+        }
+        break;
+    }
+}
+
+int
+LibUsb::open(libusb_device *p_device, libusb_device_handle **p_handle) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+    int rc;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        return libusb_open(p_device, p_handle);
+    case Mode::Record:
+        rc = libusb_open(p_device, p_handle);
+        capture(UsbCapture::Call::Open, start, rc, { deviceIndex(p_device) });
+        return rc;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::Open, { deviceIndex(p_device) }, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        if (record.m_status == LIBUSB_SUCCESS) {
+            *p_handle = reinterpret_cast<libusb_device_handle *>(&m_replayHandle);
+        }
+        replayDelay(record, start);
+        return record.m_status;
+    }
+
+    return LIBUSB_ERROR_OTHER;
+}
+
+void
+LibUsb::close(libusb_device_handle *p_handle) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        libusb_close(p_handle);
+        break;
+    case Mode::Record:
+        libusb_close(p_handle);
+        capture(UsbCapture::Call::Close, start, 0, {});
+        break;
+    case Mode::Replay:
+        if (replayNext(UsbCapture::Call::Close, {}, record)) {
+            replayDelay(record, start);
+        }
+        break;
+    }
+}
+
+int
+LibUsb::getConfiguration(libusb_device_handle *p_handle, int *p_configuration) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+    int rc;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        return libusb_get_configuration(p_handle, p_configuration);
+    case Mode::Record:
+        rc = libusb_get_configuration(p_handle, p_configuration);
+        /* The Output Argument is undefined on Failure */
+        capture(UsbCapture::Call::GetConfiguration, start, rc,
+          { (rc == LIBUSB_SUCCESS) ? static_cast<uint32_t>(*p_configuration) : 0u });
+        return rc;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::GetConfiguration, {}, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        if (record.m_status == LIBUSB_SUCCESS) {
+            *p_configuration = static_cast<int>(record.m_args[0]);
+        }
+        replayDelay(record, start);
+        return record.m_status;
+    }
+
+    return LIBUSB_ERROR_OTHER;
+}
+
+int
+LibUsb::setConfiguration(libusb_device_handle *p_handle, int p_configuration) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+    int rc;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        return libusb_set_configuration(p_handle, p_configuration);
+    case Mode::Record:
+        rc = libusb_set_configuration(p_handle, p_configuration);
+        capture(UsbCapture::Call::SetConfiguration, start, rc, { static_cast<uint32_t>(p_configuration) });
+        return rc;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::SetConfiguration, { static_cast<uint32_t>(p_configuration) }, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        replayDelay(record, start);
+        return record.m_status;
+    }
+
+    return LIBUSB_ERROR_OTHER;
+}
+
+int
+LibUsb::claimInterface(libusb_device_handle *p_handle, int p_interface) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+    int rc;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        return libusb_claim_interface(p_handle, p_interface);
+    case Mode::Record:
+        rc = libusb_claim_interface(p_handle, p_interface);
+        capture(UsbCapture::Call::ClaimInterface, start, rc, { static_cast<uint32_t>(p_interface) });
+        return rc;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::ClaimInterface, { static_cast<uint32_t>(p_interface) }, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        replayDelay(record, start);
+        return record.m_status;
+    }
+
+    return LIBUSB_ERROR_OTHER;
+}
+
+int
+LibUsb::releaseInterface(libusb_device_handle *p_handle, int p_interface) {
+    const Clock::time_point start = Clock::now();
+    UsbCapture::Record record;
+    int rc;
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        return libusb_release_interface(p_handle, p_interface);
+    case Mode::Record:
+        rc = libusb_release_interface(p_handle, p_interface);
+        capture(UsbCapture::Call::ReleaseInterface, start, rc, { static_cast<uint32_t>(p_interface) });
+        return rc;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::ReleaseInterface, { static_cast<uint32_t>(p_interface) }, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        replayDelay(record, start);
+        return record.m_status;
+    }
+
+    return LIBUSB_ERROR_OTHER;
+}
+
+/*******************************************************************************
+ * Asynchronous Transfers
+ *
+ * Submits a single Transfer and handles libusb Events until it has completed.
+ * Errors are mapped the same way libusb's own synchronous API does.
+ ******************************************************************************/
+/* Submitted, not yet completed Transfers, so they can be cancelled from another Thread */
+static std::mutex                           inFlightMutex;
+static std::set<struct libusb_transfer *>   inFlight;
+
+static void LIBUSB_CALL
+asyncTransferDone(struct libusb_transfer *p_transfer) {
+    *static_cast<int *>(p_transfer->user_data) = 1;
+}
+
+static int
+submitAndWait(libusb_context *p_ctx, struct libusb_transfer *p_transfer) {
+    int completed = 0;
+    int rc;
+
+    p_transfer->user_data = &completed;
+
+    {
+        std::lock_guard<std::mutex> lock(inFlightMutex);
+
+        rc = libusb_submit_transfer(p_transfer);
+        if (rc != LIBUSB_SUCCESS) {
+            return rc;
+        }
+        inFlight.insert(p_transfer);
+    }
+
+    while (!completed) {
+        rc = libusb_handle_events_completed(p_ctx, &completed);
+        if ((rc < 0) && (rc != LIBUSB_ERROR_INTERRUPTED)) {
+            /*
+             * libusb owns the Transfer and its Buffers until the Callback ran, so
+             * the Caller must not free them before. A cancelled Transfer completes
+             * with the next Events handled, so keep handling Events despite Errors.
+             */
+            libusb_cancel_transfer(p_transfer);
+            while (!completed) {
+                libusb_handle_events_completed(p_ctx, &completed);
+            }
+            break;
+        }
+        rc = LIBUSB_SUCCESS;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(inFlightMutex);
+        inFlight.erase(p_transfer);
+    }
+
+    if (rc < 0) {
+        return rc;
+    }
+
+    switch (p_transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED:     return LIBUSB_SUCCESS;
+    case LIBUSB_TRANSFER_TIMED_OUT:     return LIBUSB_ERROR_TIMEOUT;
+    case LIBUSB_TRANSFER_STALL:         return LIBUSB_ERROR_PIPE;
+    case LIBUSB_TRANSFER_OVERFLOW:      return LIBUSB_ERROR_OVERFLOW;
+    case LIBUSB_TRANSFER_NO_DEVICE:     return LIBUSB_ERROR_NO_DEVICE;
+    case LIBUSB_TRANSFER_ERROR:         return LIBUSB_ERROR_IO;
+    case LIBUSB_TRANSFER_CANCELLED:
+        /* Cancelled by the Watchdog, see LibUsb::cancelTransfers() */
+        return DeviceWatchdog::dead() ? LIBUSB_ERROR_NO_DEVICE : LIBUSB_ERROR_IO;
+    }
+
+    return LIBUSB_ERROR_OTHER;
+}
+
+void
+LibUsb::cancelTransfers(void) {
+    std::lock_guard<std::mutex> lock(inFlightMutex);
+
+    for (struct libusb_transfer * const transfer : inFlight) {
+        /* Completion is reported to the Thread waiting for the Transfer */
+        libusb_cancel_transfer(transfer);
+    }
+}
+
+static int
+asyncControlTransfer(libusb_context *p_ctx, libusb_device_handle *p_handle, uint8_t p_requestType, uint8_t p_request,
+  uint16_t p_value, uint16_t p_index, unsigned char *p_data, uint16_t p_length, unsigned p_timeout)
+{
+    struct libusb_transfer * const transfer = libusb_alloc_transfer(0);
+    if (transfer == nullptr) {
+        return LIBUSB_ERROR_NO_MEM;
+    }
+
+    std::vector<unsigned char> buffer(LIBUSB_CONTROL_SETUP_SIZE + p_length);
+    libusb_fill_control_setup(buffer.data(), p_requestType, p_request, p_value, p_index, p_length);
+    if ((p_requestType & LIBUSB_ENDPOINT_IN) == 0) {
+        ::memcpy(buffer.data() + LIBUSB_CONTROL_SETUP_SIZE, p_data, p_length);
+    }
+    libusb_fill_control_transfer(transfer, p_handle, buffer.data(), asyncTransferDone, nullptr, p_timeout);
+
+    int rc = submitAndWait(p_ctx, transfer);
+    if (rc == LIBUSB_SUCCESS) {
+        if ((p_requestType & LIBUSB_ENDPOINT_IN) != 0) {
+            ::memcpy(p_data, libusb_control_transfer_get_data(transfer), transfer->actual_length);
+        }
+        rc = transfer->actual_length;
+    }
+
+    libusb_free_transfer(transfer);
+
+    return rc;
+}
+
+static int
+asyncBulkTransfer(libusb_context *p_ctx, libusb_device_handle *p_handle, unsigned char p_endpoint, unsigned char *p_data,
+  int p_length, int *p_transferred, unsigned p_timeout)
+{
+    struct libusb_transfer * const transfer = libusb_alloc_transfer(0);
+    if (transfer == nullptr) {
+        return LIBUSB_ERROR_NO_MEM;
+    }
+
+    libusb_fill_bulk_transfer(transfer, p_handle, p_endpoint, p_data, p_length, asyncTransferDone, nullptr, p_timeout);
+
+    const int rc = submitAndWait(p_ctx, transfer);
+    *p_transferred = transfer->actual_length;
+
+    libusb_free_transfer(transfer);
+
+    return rc;
+}
+
+/*
+ * Arguments: { bmRequestType | (bRequest << 8), wValue | (wIndex << 16), wLength, Timeout }
+ * Data: Bytes received from the Device (Device-to-Host Requests only)
+ */
+template<typename TransferFn>
+int
+LibUsb::doControlTransfer(TransferFn p_transfer, uint8_t p_requestType, uint8_t p_request,
+  uint16_t p_value, uint16_t p_index, unsigned char *p_data, uint16_t p_length, unsigned p_timeout)
+{
+    const Clock::time_point start = Clock::now();
+    const uint32_t request = p_requestType | (p_request << 8);
+    const uint32_t valueIndex = p_value | (p_index << 16);
+    const bool deviceToHost = (p_requestType & LIBUSB_ENDPOINT_IN) != 0;
+    UsbCapture::Record record;
+    int rc = LIBUSB_ERROR_OTHER;
+
+    /* Fail fast instead of waiting for the Timeout of a Device that is known to be dead */
+    if (DeviceWatchdog::dead()) {
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        rc = p_transfer();
+        break;
+    case Mode::Record:
+        rc = p_transfer();
+        capture(UsbCapture::Call::ControlTransfer, start, rc, { request, valueIndex, p_length, p_timeout },
+          p_data, (deviceToHost && (rc > 0)) ? rc : 0);
+        break;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::ControlTransfer, { request, valueIndex, p_length }, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        ::memcpy(p_data, record.m_data, std::min<size_t>(record.m_length, p_length));
+        replayDelay(record, start);
+        rc = record.m_status;
+        break;
+    }
+
+    const Clock::duration latency = Clock::now() - start;
+    UsbMetrics::transfer(UsbMetrics::Transfer::Control, deviceToHost, std::max(rc, 0), rc, latency);
+    DeviceWatchdog::transfer(UsbMetrics::Transfer::Control, rc, latency);
+
+    return rc;
+}
+
+int
+LibUsb::controlTransfer(libusb_device_handle *p_handle, uint8_t p_requestType, uint8_t p_request,
+  uint16_t p_value, uint16_t p_index, unsigned char *p_data, uint16_t p_length, unsigned p_timeout)
+{
+    return doControlTransfer([&] {
+        return libusb_control_transfer(p_handle, p_requestType, p_request, p_value, p_index, p_data, p_length, p_timeout);
+    }, p_requestType, p_request, p_value, p_index, p_data, p_length, p_timeout);
+}
+
+int
+LibUsb::controlTransferAsync(libusb_context *p_ctx, libusb_device_handle *p_handle, uint8_t p_requestType, uint8_t p_request,
+  uint16_t p_value, uint16_t p_index, unsigned char *p_data, uint16_t p_length, unsigned p_timeout)
+{
+    return doControlTransfer([&] {
+        return asyncControlTransfer(p_ctx, p_handle, p_requestType, p_request, p_value, p_index, p_data, p_length, p_timeout);
+    }, p_requestType, p_request, p_value, p_index, p_data, p_length, p_timeout);
+}
+
+/*
+ * Arguments: { Endpoint, Length, Transferred Length, Timeout }
+ * Data: Bytes received from the Device (IN Endpoints only)
+ */
+template<typename TransferFn>
+int
+LibUsb::doBulkTransfer(TransferFn p_transfer, unsigned char p_endpoint, unsigned char *p_data,
+  int p_length, int *p_transferred, unsigned p_timeout)
+{
+    const Clock::time_point start = Clock::now();
+    const bool in = (p_endpoint & LIBUSB_ENDPOINT_IN) != 0;
+    UsbCapture::Record record;
+    int rc = LIBUSB_ERROR_OTHER;
+
+    if (DeviceWatchdog::dead()) {
+        *p_transferred = 0;
+        return LIBUSB_ERROR_NO_DEVICE;
+    }
+
+    switch (m_mode) {
+    case Mode::Passthrough:
+        rc = p_transfer();
+        break;
+    case Mode::Record:
+        rc = p_transfer();
+        capture(UsbCapture::Call::BulkTransfer, start, rc,
+          { p_endpoint, static_cast<uint32_t>(p_length), static_cast<uint32_t>(*p_transferred), p_timeout },
+          p_data, in ? *p_transferred : 0);
+        break;
+    case Mode::Replay:
+        if (!replayNext(UsbCapture::Call::BulkTransfer, { p_endpoint, static_cast<uint32_t>(p_length) }, record)) {
+            return LIBUSB_ERROR_OTHER;
+        }
+        ::memcpy(p_data, record.m_data, std::min<size_t>(record.m_length, p_length));
+        *p_transferred = static_cast<int>(record.m_args[2]);
+        replayDelay(record, start);
+        rc = record.m_status;
+        break;
+    }
+
+    const Clock::duration latency = Clock::now() - start;
+    UsbMetrics::transfer(UsbMetrics::Transfer::Bulk, in, *p_transferred, rc, latency);
+    DeviceWatchdog::transfer(UsbMetrics::Transfer::Bulk, rc, latency);
+
+    return rc;
+}
+
+int
+LibUsb::bulkTransfer(libusb_device_handle *p_handle, unsigned char p_endpoint, unsigned char *p_data,
+  int p_length, int *p_transferred, unsigned p_timeout)
+{
+    return doBulkTransfer([&] {
+        return libusb_bulk_transfer(p_handle, p_endpoint, p_data, p_length, p_transferred, p_timeout);
+    }, p_endpoint, p_data, p_length, p_transferred, p_timeout);
+}
+
+int
+LibUsb::bulkTransferAsync(libusb_context *p_ctx, libusb_device_handle *p_handle, unsigned char p_endpoint, unsigned char *p_data,
+  int p_length, int *p_transferred, unsigned p_timeout)
+{
+    return doBulkTransfer([&] {
+        return asyncBulkTransfer(p_ctx, p_handle, p_endpoint, p_data, p_length, p_transferred, p_timeout);
+    }, p_endpoint, p_data, p_length, p_transferred, p_timeout);
+}
@@ -0,0 +1,129 @@
+/*-
+ * $Copyright$
+ */
+
+#ifndef LIB_USB_HPP_3A8E5C17_D24B_4F61_9C0A_E7B5281F46D3
+#define LIB_USB_HPP_3A8E5C17_D24B_4F61_9C0A_E7B5281F46D3
+
+#include <libusb-1.0/libusb.h>
+
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+
+#include "UsbCapture.hpp"
+
+/*
+ * Entry Point for all libusb Calls made by the Test Fixtures.
+ *
+ * By default, each Call is passed straight through to libusb. In "Record" Mode,
+ * every Call is additionally written to a Capture File together with its
+ * Arguments, returned Data, Status and Timing. In "Replay" Mode, libusb is not
+ * used at all; instead, the Calls are served from a previously recorded Capture
+ * File, either with the recorded Timing or as fast as possible. This allows to
+ * profile the Test Harness against real Device behaviour without a Device.
+ *
+ * Replay requires the Tests to issue the same sequence of Calls as during the
+ * Recording, i.e. the same Test Filter and the same Random Seed (which is
+ * stored in the Capture File, see main.cpp).
+ */
+class LibUsb {
+public:
+    enum class Mode {
+        Passthrough,
+        Record,
+        Replay
+    };
+
+    enum class Timing {
+        Original,
+        Fast
+    };
+
+    static bool record(const std::string &p_path, uint32_t p_seed, std::string &p_error);
+    static bool replay(const std::string &p_path, Timing p_timing, std::string &p_error);
+    /* Returns false if the Capture File could not be completed */
+    static bool finish(void);
+
+    static Mode     mode(void) { return m_mode; }
+    /* True once a Replay no longer matches the Capture File; all further Calls fail */
+    static bool     diverged(void);
+    static uint32_t replaySeed(void) { return m_reader.seed(); }
+
+    static int      init(libusb_context **p_ctx);
+    static void     exit(libusb_context *p_ctx);
+    static int      setOption(libusb_context *p_ctx, enum libusb_option p_option, int p_value);
+
+    static ssize_t  getDeviceList(libusb_context *p_ctx, libusb_device ***p_list);
+    static void     freeDeviceList(libusb_device **p_list, int p_unrefDevices);
+    static libusb_device * refDevice(libusb_device *p_device);
+    static void     unrefDevice(libusb_device *p_device);
+
+    static int      getDeviceDescriptor(libusb_device *p_device, struct libusb_device_descriptor *p_descriptor);
+    static int      getActiveConfigDescriptor(libusb_device *p_device, struct libusb_config_descriptor **p_config);
+    static void     freeConfigDescriptor(struct libusb_config_descriptor *p_config);
+
+    static int      open(libusb_device *p_device, libusb_device_handle **p_handle);
+    static void     close(libusb_device_handle *p_handle);
+
+    static int      getConfiguration(libusb_device_handle *p_handle, int *p_configuration);
+    static int      setConfiguration(libusb_device_handle *p_handle, int p_configuration);
+    static int      claimInterface(libusb_device_handle *p_handle, int p_interface);
+    static int      releaseInterface(libusb_device_handle *p_handle, int p_interface);
+
+    static int      controlTransfer(libusb_device_handle *p_handle, uint8_t p_requestType, uint8_t p_request,
+                      uint16_t p_value, uint16_t p_index, unsigned char *p_data, uint16_t p_length, unsigned p_timeout);
+    static int      bulkTransfer(libusb_device_handle *p_handle, unsigned char p_endpoint, unsigned char *p_data,
+                      int p_length, int *p_transferred, unsigned p_timeout);
+
+    /* Same as above, but implemented with libusb's asynchronous API */
+    static int      controlTransferAsync(libusb_context *p_ctx, libusb_device_handle *p_handle, uint8_t p_requestType,
+                      uint8_t p_request, uint16_t p_value, uint16_t p_index, unsigned char *p_data, uint16_t p_length,
+                      unsigned p_timeout);
+    static int      bulkTransferAsync(libusb_context *p_ctx, libusb_device_handle *p_handle, unsigned char p_endpoint,
+                      unsigned char *p_data, int p_length, int *p_transferred, unsigned p_timeout);
+
+    /* Cancels all in-flight asynchronous Transfers; synchronous Transfers cannot be cancelled */
+    static void     cancelTransfers(void);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static Mode                 m_mode;
+    static Timing               m_timing;
+    static Clock::time_point    m_epoch;
+    static UsbCaptureWriter     m_writer;
+    static UsbCaptureReader     m_reader;
+    static std::mutex           m_replayMutex;
+    static bool                 m_diverged;
+
+    /* Device List seen during Recording, used to store Devices by Index */
+    static libusb_device **     m_deviceList;
+    static ssize_t              m_deviceCount;
+
+    /* Stand-ins for the opaque libusb Objects during Replay */
+    static char                 m_replayContext;
+    static char                 m_replayHandle;
+    static char                 m_replayDevices[256];
+
+    static uint32_t deviceIndex(libusb_device *p_device);
+
+    static void capture(UsbCapture::Call p_call, const Clock::time_point &p_start, int p_status,
+      std::initializer_list<uint32_t> p_args, const void *p_data = nullptr, size_t p_length = 0);
+
+    /* Fetches the next Record and checks that it matches the Call and its p_inputs Arguments */
+    static bool replayNext(UsbCapture::Call p_call, std::initializer_list<uint32_t> p_inputs, UsbCapture::Record &p_record);
+    static void replayDelay(const UsbCapture::Record &p_record, const Clock::time_point &p_start);
+
+    /* Record, Replay and Metrics for Transfers; p_transfer performs the actual Transfer */
+    template<typename TransferFn>
+    static int doControlTransfer(TransferFn p_transfer, uint8_t p_requestType, uint8_t p_request,
+      uint16_t p_value, uint16_t p_index, unsigned char *p_data, uint16_t p_length, unsigned p_timeout);
+    template<typename TransferFn>
+    static int doBulkTransfer(TransferFn p_transfer, unsigned char p_endpoint, unsigned char *p_data,
+      int p_length, int *p_transferred, unsigned p_timeout);
+};
+
+#endif /* LIB_USB_HPP_3A8E5C17_D24B_4F61_9C0A_E7B5281F46D3 */
@@ -0,0 +1,486 @@
+/*-
+ * $Copyright$
+ */
+
+#include "UsbCapture.hpp"
+
+#include <libusb-1.0/libusb.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char      UsbCapture::m_magic[8]      = { 'U', 'S', 'B', 'C', 'A', 'P', '\0', '\0' };
+const uint32_t  UsbCapture::m_version       = 1;
+
+const char *
+UsbCapture::name(Call p_call) {
+    switch (p_call) {
+    case Call::Init:                        return "libusb_init";
+    case Call::Exit:                        return "libusb_exit";
+    case Call::SetOption:                   return "libusb_set_option";
+    case Call::GetDeviceList:               return "libusb_get_device_list";
+    case Call::FreeDeviceList:              return "libusb_free_device_list";
+    case Call::RefDevice:                   return "libusb_ref_device";
+    case Call::UnrefDevice:                 return "libusb_unref_device";
+    case Call::GetDeviceDescriptor:         return "libusb_get_device_descriptor";
+    case Call::GetActiveConfigDescriptor:   return "libusb_get_active_config_descriptor";
+    case Call::FreeConfigDescriptor:        return "libusb_free_config_descriptor";
+    case Call::Open:                        return "libusb_open";
+    case Call::Close:                       return "libusb_close";
+    case Call::GetConfiguration:            return "libusb_get_configuration";
+    case Call::SetConfiguration:            return "libusb_set_configuration";
+    case Call::ClaimInterface:              return "libusb_claim_interface";
+    case Call::ReleaseInterface:            return "libusb_release_interface";
+    case Call::ControlTransfer:             return "libusb_control_transfer";
+    case Call::BulkTransfer:                return "libusb_bulk_transfer";
+    }
+
+    return "(unknown)";
+}
+
+template<typename T>
+static uint8_t *
+put(uint8_t *p_dst, const T &p_value) {
+    ::memcpy(p_dst, &p_value, sizeof(p_value));
+    return p_dst + sizeof(p_value);
+}
+
+template<typename T>
+static const uint8_t *
+get(const uint8_t *p_src, T &p_value) {
+    ::memcpy(&p_value, p_src, sizeof(p_value));
+    return p_src + sizeof(p_value);
+}
+
+/*******************************************************************************
+ * Serialization of Configuration Descriptors
+ *
+ * The Configuration Descriptor returned by libusb is a tree of structures. It is
+ * stored field by field, each structure's "extra" bytes prefixed by their length.
+ ******************************************************************************/
+class DescriptorWriter {
+    std::vector<uint8_t> &  m_buffer;
+
+public:
+    DescriptorWriter(std::vector<uint8_t> &p_buffer) : m_buffer(p_buffer) {
+
+    }
+
+    template<typename T>
+    void put(const T &p_value) {
+        const uint8_t * const bytes = reinterpret_cast<const uint8_t *>(&p_value);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(p_value));
+    }
+
+    void putExtra(const unsigned char *p_extra, int p_length) {
+        put(static_cast<uint32_t>(p_length));
+        if (p_length > 0) {
+            m_buffer.insert(m_buffer.end(), p_extra, p_extra + p_length);
+        }
+    }
+};
+
+class DescriptorReader {
+    const uint8_t *         m_pos;
+    const uint8_t * const   m_end;
+    bool                    m_valid;
+
+public:
+    DescriptorReader(const uint8_t *p_data, size_t p_length) : m_pos(p_data), m_end(p_data + p_length), m_valid(true) {
+
+    }
+
+    bool valid(void) const { return m_valid; }
+
+    template<typename T>
+    void get(T &p_value) {
+        if (static_cast<size_t>(m_end - m_pos) < sizeof(p_value)) {
+            m_valid = false;
+            p_value = T();
+            return;
+        }
+        ::memcpy(&p_value, m_pos, sizeof(p_value));
+        m_pos += sizeof(p_value);
+    }
+
+    void getExtra(const unsigned char *&p_extra, int &p_length) {
+        uint32_t length;
+
+        get(length);
+        p_extra = nullptr;
+        p_length = 0;
+
+        if (!m_valid || (length == 0)) {
+            return;
+        }
+        if (static_cast<size_t>(m_end - m_pos) < length) {
+            m_valid = false;
+            return;
+        }
+
+        unsigned char * const extra = new unsigned char[length];
+        ::memcpy(extra, m_pos, length);
+        m_pos += length;
+
+        p_extra = extra;
+        p_length = length;
+    }
+};
+
+void
+UsbCapture::serializeConfigDescriptor(const struct libusb_config_descriptor &p_config, std::vector<uint8_t> &p_buffer) {
+    DescriptorWriter w(p_buffer);
+
+    w.put(p_config.bLength);
+    w.put(p_config.bDescriptorType);
+    w.put(p_config.wTotalLength);
+    w.put(p_config.bNumInterfaces);
+    w.put(p_config.bConfigurationValue);
+    w.put(p_config.iConfiguration);
+    w.put(p_config.bmAttributes);
+    w.put(p_config.MaxPower);
+    w.putExtra(p_config.extra, p_config.extra_length);
+
+    for (unsigned i = 0; i < p_config.bNumInterfaces; i++) {
+        const struct libusb_interface &interface = p_config.interface[i];
+
+        w.put(static_cast<uint32_t>(interface.num_altsetting));
+        for (int a = 0; a < interface.num_altsetting; a++) {
+            const struct libusb_interface_descriptor &alt = interface.altsetting[a];
+
+            w.put(alt.bLength);
+            w.put(alt.bDescriptorType);
+            w.put(alt.bInterfaceNumber);
+            w.put(alt.bAlternateSetting);
+            w.put(alt.bNumEndpoints);
+            w.put(alt.bInterfaceClass);
+            w.put(alt.bInterfaceSubClass);
+            w.put(alt.bInterfaceProtocol);
+            w.put(alt.iInterface);
+            w.putExtra(alt.extra, alt.extra_length);
+
+            for (unsigned e = 0; e < alt.bNumEndpoints; e++) {
+                const struct libusb_endpoint_descriptor &endpt = alt.endpoint[e];
+
+                w.put(endpt.bLength);
+                w.put(endpt.bDescriptorType);
+                w.put(endpt.bEndpointAddress);
+                w.put(endpt.bmAttributes);
+                w.put(endpt.wMaxPacketSize);
+                w.put(endpt.bInterval);
+                w.put(endpt.bRefresh);
+                w.put(endpt.bSynchAddress);
+                w.putExtra(endpt.extra, endpt.extra_length);
+            }
+        }
+    }
+}
+
+void
+UsbCapture::freeConfigDescriptor(struct libusb_config_descriptor *p_config) {
+    if (p_config == nullptr) {
+        return;
+    }
+
+    for (unsigned i = 0; (p_config->interface != nullptr) && (i < p_config->bNumInterfaces); i++) {
+        const struct libusb_interface &interface = p_config->interface[i];
+
+        for (int a = 0; (interface.altsetting != nullptr) && (a < interface.num_altsetting); a++) {
+            const struct libusb_interface_descriptor &alt = interface.altsetting[a];
+
+            for (unsigned e = 0; (alt.endpoint != nullptr) && (e < alt.bNumEndpoints); e++) {
+                delete[] alt.endpoint[e].extra;
+            }
+            delete[] alt.endpoint;
+            delete[] alt.extra;
+        }
+        delete[] interface.altsetting;
+    }
+    delete[] p_config->interface;
+    delete[] p_config->extra;
+    delete p_config;
+}
+
+struct libusb_config_descriptor *
+UsbCapture::deserializeConfigDescriptor(const uint8_t *p_data, size_t p_length) {
+    DescriptorReader r(p_data, p_length);
+    struct libusb_config_descriptor * const config = new libusb_config_descriptor();
+
+    r.get(config->bLength);
+    r.get(config->bDescriptorType);
+    r.get(config->wTotalLength);
+    r.get(config->bNumInterfaces);
+    r.get(config->bConfigurationValue);
+    r.get(config->iConfiguration);
+    r.get(config->bmAttributes);
+    r.get(config->MaxPower);
+    r.getExtra(config->extra, config->extra_length);
+
+    struct libusb_interface * const interfaces = new libusb_interface[config->bNumInterfaces]();
+    config->interface = interfaces;
+
+    for (unsigned i = 0; r.valid() && (i < config->bNumInterfaces); i++) {
+        uint32_t numAltsetting;
+
+        r.get(numAltsetting);
+        if (numAltsetting > 255) {
+            freeConfigDescriptor(config);
+            return nullptr;
+        }
+
+        struct libusb_interface_descriptor * const alts = new libusb_interface_descriptor[numAltsetting]();
+        interfaces[i].altsetting = alts;
+        interfaces[i].num_altsetting = numAltsetting;
+
+        for (unsigned a = 0; r.valid() && (a < numAltsetting); a++) {
+            struct libusb_interface_descriptor &alt = alts[a];
+
+            r.get(alt.bLength);
+            r.get(alt.bDescriptorType);
+            r.get(alt.bInterfaceNumber);
+            r.get(alt.bAlternateSetting);
+            r.get(alt.bNumEndpoints);
+            r.get(alt.bInterfaceClass);
+            r.get(alt.bInterfaceSubClass);
+            r.get(alt.bInterfaceProtocol);
+            r.get(alt.iInterface);
+            r.getExtra(alt.extra, alt.extra_length);
+
+            struct libusb_endpoint_descriptor * const endpts = new libusb_endpoint_descriptor[alt.bNumEndpoints]();
+            alt.endpoint = endpts;
+
+            for (unsigned e = 0; r.valid() && (e < alt.bNumEndpoints); e++) {
+                struct libusb_endpoint_descriptor &endpt = endpts[e];
+
+                r.get(endpt.bLength);
+                r.get(endpt.bDescriptorType);
+                r.get(endpt.bEndpointAddress);
+                r.get(endpt.bmAttributes);
+                r.get(endpt.wMaxPacketSize);
+                r.get(endpt.bInterval);
+                r.get(endpt.bRefresh);
+                r.get(endpt.bSynchAddress);
+                r.getExtra(endpt.extra, endpt.extra_length);
+            }
+        }
+    }
+
+    if (!r.valid()) {
+        freeConfigDescriptor(config);
+        return nullptr;
+    }
+
+    return config;
+}
+
+/*******************************************************************************
+ * Writer
+ ******************************************************************************/
+UsbCaptureWriter::UsbCaptureWriter(void)
+  : m_file(nullptr)
+{
+
+}
+
+UsbCaptureWriter::~UsbCaptureWriter() {
+    close();
+}
+
+bool
+UsbCaptureWriter::open(const std::string &p_path, uint32_t p_seed) {
+    uint8_t header[UsbCapture::m_fileHeaderSz];
+    uint8_t *pos = header;
+
+    close();
+
+    m_file = std::fopen(p_path.c_str(), "wb");
+    if (m_file == nullptr) {
+        return false;
+    }
+
+    ::memcpy(pos, UsbCapture::m_magic, sizeof(UsbCapture::m_magic));
+    pos += sizeof(UsbCapture::m_magic);
+    pos = put(pos, UsbCapture::m_version);
+    pos = put(pos, p_seed);
+
+    return (std::fwrite(header, sizeof(header), 1, m_file) == 1);
+}
+
+bool
+UsbCaptureWriter::fail(void) {
+    m_error = ::strerror(errno);
+
+    std::fclose(m_file);
+    m_file = nullptr;
+
+    return false;
+}
+
+bool
+UsbCaptureWriter::write(const UsbCapture::Record &p_record) {
+    uint8_t header[UsbCapture::m_recordHeaderSz];
+    uint8_t *pos = header;
+
+    pos = put(pos, static_cast<uint16_t>(p_record.m_call));
+    pos = put(pos, static_cast<uint16_t>(0));
+    pos = put(pos, p_record.m_status);
+    pos = put(pos, p_record.m_offset);
+    pos = put(pos, p_record.m_duration);
+    for (unsigned idx = 0; idx < UsbCapture::m_numArgs; idx++) {
+        pos = put(pos, p_record.m_args[idx]);
+    }
+    pos = put(pos, p_record.m_length);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_file == nullptr) {
+        return true;
+    }
+
+    if (std::fwrite(header, sizeof(header), 1, m_file) != 1) {
+        return fail();
+    }
+    if ((p_record.m_length > 0) && (std::fwrite(p_record.m_data, p_record.m_length, 1, m_file) != 1)) {
+        return fail();
+    }
+
+    return true;
+}
+
+bool
+UsbCaptureWriter::close(void) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_file == nullptr) {
+        return true;
+    }
+
+    const bool flushed = (std::fflush(m_file) == 0);
+    if (!flushed) {
+        m_error = ::strerror(errno);
+    }
+
+    std::fclose(m_file);
+    m_file = nullptr;
+
+    return flushed;
+}
+
+/*******************************************************************************
+ * Reader
+ ******************************************************************************/
+UsbCaptureReader::UsbCaptureReader(void)
+  : m_base(nullptr), m_size(0), m_pos(0), m_index(0), m_seed(0)
+{
+
+}
+
+UsbCaptureReader::~UsbCaptureReader() {
+    close();
+}
+
+bool
+UsbCaptureReader::open(const std::string &p_path, std::string &p_error) {
+    close();
+
+    int fd = ::open(p_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        p_error = "Cannot open '" + p_path + "': " + ::strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        p_error = "Cannot stat '" + p_path + "': " + ::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    if (static_cast<size_t>(st.st_size) < UsbCapture::m_fileHeaderSz) {
+        p_error = "'" + p_path + "' is not a USB Capture File (too short)";
+        ::close(fd);
+        return false;
+    }
+
+    void *base = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        p_error = "Cannot map '" + p_path + "': " + ::strerror(errno);
+        return false;
+    }
+    ::madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+    m_base = static_cast<const uint8_t *>(base);
+    m_size = st.st_size;
+
+    uint32_t version;
+    const uint8_t *pos = m_base + sizeof(UsbCapture::m_magic);
+    pos = get(pos, version);
+    pos = get(pos, m_seed);
+
+    if (::memcmp(m_base, UsbCapture::m_magic, sizeof(UsbCapture::m_magic)) != 0) {
+        p_error = "'" + p_path + "' is not a USB Capture File (bad magic)";
+        close();
+        return false;
+    }
+
+    if (version != UsbCapture::m_version) {
+        p_error = "'" + p_path + "' has unsupported version " + std::to_string(version);
+        close();
+        return false;
+    }
+
+    m_pos = pos - m_base;
+    m_index = 0;
+
+    return true;
+}
+
+void
+UsbCaptureReader::close(void) {
+    if (m_base != nullptr) {
+        ::munmap(const_cast<uint8_t *>(m_base), m_size);
+    }
+
+    m_base = nullptr;
+    m_size = 0;
+    m_pos = 0;
+    m_index = 0;
+}
+
+bool
+UsbCaptureReader::next(UsbCapture::Record &p_record) {
+    if ((m_base == nullptr) || ((m_size - m_pos) < UsbCapture::m_recordHeaderSz)) {
+        return false;
+    }
+
+    const uint8_t *pos = m_base + m_pos;
+    uint16_t call, reserved;
+
+    pos = get(pos, call);
+    pos = get(pos, reserved);
+    pos = get(pos, p_record.m_status);
+    pos = get(pos, p_record.m_offset);
+    pos = get(pos, p_record.m_duration);
+    for (unsigned idx = 0; idx < UsbCapture::m_numArgs; idx++) {
+        pos = get(pos, p_record.m_args[idx]);
+    }
+    pos = get(pos, p_record.m_length);
+
+    if (static_cast<size_t>((m_base + m_size) - pos) < p_record.m_length) {
+        return false;
+    }
+
+    p_record.m_call = static_cast<UsbCapture::Call>(call);
+    p_record.m_data = pos;
+
+    m_pos = (pos - m_base) + p_record.m_length;
+    m_index++;
+
+    return true;
+}
@@ -0,0 +1,142 @@
+/*-
+ * $Copyright$
+ */
+
+#ifndef USB_CAPTURE_HPP_9D3B6E21_4F7A_4C58_B1E2_08A6C5D4F937
+#define USB_CAPTURE_HPP_9D3B6E21_4F7A_4C58_B1E2_08A6C5D4F937
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct libusb_config_descriptor;
+
+/*
+ * Binary Capture of the libusb Calls made by the Test Fixtures.
+ *
+ * A Capture File starts with a 16 Byte File Header followed by a sequence of
+ * Records. Records are only ever appended. All fields are stored in the host's
+ * byte order; the Magic Number and the Version in the File Header are used to
+ * reject files from incompatible hosts or versions.
+ *
+ *   File Header:   char magic[8], uint32_t version, uint32_t seed
+ *   Record:        uint16_t call, uint16_t reserved, int32_t status,
+ *                  uint64_t offset, uint32_t duration, uint32_t args[4],
+ *                  uint32_t length, uint8_t data[length]
+ *
+ * The "offset" is the time from the start of the Capture to the start of the
+ * Call and "duration" the time the Call took, both in Nanoseconds. The meaning
+ * of "args" and "data" depends on the Call, see LibUsb.cpp.
+ */
+class UsbCapture {
+public:
+    enum class Call : uint16_t {
+        Init = 1,
+        Exit,
+        SetOption,
+        GetDeviceList,
+        FreeDeviceList,
+        RefDevice,
+        UnrefDevice,
+        GetDeviceDescriptor,
+        GetActiveConfigDescriptor,
+        FreeConfigDescriptor,
+        Open,
+        Close,
+        GetConfiguration,
+        SetConfiguration,
+        ClaimInterface,
+        ReleaseInterface,
+        ControlTransfer,
+        BulkTransfer,
+    };
+
+    static constexpr size_t m_numArgs = 4;
+
+    struct Record {
+        Call            m_call;
+        int32_t         m_status;
+        uint64_t        m_offset;
+        uint32_t        m_duration;     /* Saturates at UINT32_MAX (~4.3s) */
+        uint32_t        m_args[m_numArgs];
+        uint32_t        m_length;
+        const uint8_t * m_data;
+    };
+
+    static const char       m_magic[8];
+    static const uint32_t   m_version;
+
+    static constexpr size_t m_fileHeaderSz      = 8 + sizeof(uint32_t) + sizeof(uint32_t);
+    static constexpr size_t m_recordHeaderSz    = sizeof(uint16_t) + sizeof(uint16_t) + sizeof(int32_t)
+                                                + sizeof(uint64_t) + sizeof(uint32_t)
+                                                + (m_numArgs * sizeof(uint32_t)) + sizeof(uint32_t);
+
+    static const char * name(Call p_call);
+
+    /* Data of a GetActiveConfigDescriptor Record */
+    static void serializeConfigDescriptor(const struct libusb_config_descriptor &p_config, std::vector<uint8_t> &p_buffer);
+
+    /* Returns nullptr if p_data is truncated; free the Result with freeConfigDescriptor(), not with libusb */
+    static struct libusb_config_descriptor * deserializeConfigDescriptor(const uint8_t *p_data, size_t p_length);
+    static void freeConfigDescriptor(struct libusb_config_descriptor *p_config);
+};
+
+/*
+ * Appends Records to a Capture File. May be used from multiple threads.
+ */
+class UsbCaptureWriter {
+    std::FILE *     m_file;
+    std::mutex      m_mutex;
+    std::string     m_error;
+
+    bool fail(void);
+
+public:
+    UsbCaptureWriter(void);
+    ~UsbCaptureWriter();
+
+    bool open(const std::string &p_path, uint32_t p_seed);
+
+    /*
+     * Returns false for the first Record that cannot be written, e.g. on a full
+     * Disk. The Capture File is closed then and all further Records are dropped;
+     * a Replay of it ends at the first incomplete Record.
+     */
+    bool write(const UsbCapture::Record &p_record);
+
+    /* Returns false if buffered Records could not be flushed */
+    bool close(void);
+
+    const std::string & error(void) const { return m_error; }
+};
+
+/*
+ * Reads the Records of a memory-mapped Capture File in order.
+ */
+class UsbCaptureReader {
+    const uint8_t * m_base;
+    size_t          m_size;
+    size_t          m_pos;
+    size_t          m_index;
+    uint32_t        m_seed;
+
+public:
+    UsbCaptureReader(void);
+    ~UsbCaptureReader();
+
+    bool open(const std::string &p_path, std::string &p_error);
+    void close(void);
+
+    uint32_t seed(void) const { return m_seed; }
+
+    /* Index of the Record returned by the next call to next() */
+    size_t index(void) const { return m_index; }
+
+    /* Returns false at the end of the Capture or if the Capture is truncated */
+    bool next(UsbCapture::Record &p_record);
+};
+
+#endif /* USB_CAPTURE_HPP_9D3B6E21_4F7A_4C58_B1E2_08A6C5D4F937 */
@@ -8,39 +8,28 @@
 #include <gtest/gtest.h>
 #include <libusb-1.0/libusb.h>
 #include <cstdint>
+#include <iostream>
 
-class UsbDeviceTest : public ::testing::Test {
-    static const uint16_t   m_vendorId;
-    static const uint16_t   m_deviceId;
-    static const uint8_t    m_interfaceClass;
-    static const uint8_t    m_interfaceProtocol;
-    static const uint8_t    m_interfaceSubClass;
-
-    static const int        m_testConfiguration;
-    static const int        m_testInterface;
-
-    libusb_context *        m_ctx;
-    libusb_device **        m_devs;
-    libusb_device *         m_dutRef;
-
-    int                     m_activeConfiguration;
-
-    struct libusb_device_descriptor             m_deviceDescriptor;
-    const struct libusb_config_descriptor *     m_configDescriptor;
-    const struct libusb_interface_descriptor *  m_interfaceDescriptor;
-
-
-    void libUsbInit(void);
-    void openDevice(void);
-    void activateDeviceConfiguration(void);
-    void parseDeviceDescriptor(void);
-    void parseConfigDescriptor(void);
-    void parseInterfaceDescriptor(void);
-
-    void resetDeviceConfiguration(void);
-    void closeDevice(void);
-    void libUsbCleanUp(void);
+#include "DeviceWatchdog.hpp"
+#include "FixturePhases.hpp"
+#include "UsbTransport.hpp"
 
+/*
+ * Base Fixture for Tests against the USB Device under Test.
+ *
+ * The Fixture is templated on the Transport (see UsbTransport.hpp) that all
+ * libusb Calls are issued through. The individual Set-up Phases are exposed to
+ * derived Fixtures, so a Fixture that only needs e.g. an open Device can run
+ * just those Phases; libUsbCleanUp() only undoes the Phases that completed.
+ *
+ * The Wall-Time of every Phase is recorded in the Test Results, and summed up
+ * per Test Suite (see FixturePhases.hpp).
+ *
+ * Once the DeviceWatchdog declared the Device dead, Tests are skipped before
+ * any Set-up Phase runs. After a failed Test, the Device's Health is checked.
+ */
+template<typename Transport>
+class UsbDeviceTest : public ::testing::Test {
     static
     enum libusb_endpoint_direction
     getEndpointDirection(const struct libusb_endpoint_descriptor &p_endptDescriptor) {
@@ -53,8 +42,31 @@ class UsbDeviceTest : public ::testing::Test {
         return static_cast<enum libusb_transfer_type>(((p_endptDescriptor.bmAttributes >> 0) & 0b11));
     }
 
-
 protected:
+    static constexpr uint16_t   m_vendorId              = 0xdead;
+    static constexpr uint16_t   m_deviceId              = 0xbeef;
+    static constexpr uint8_t    m_interfaceClass        = LIBUSB_CLASS_VENDOR_SPEC;
+    static constexpr uint8_t    m_interfaceSubClass     = 0x10;
+    static constexpr uint8_t    m_interfaceProtocol     = 0x0B;
+
+    static constexpr int        m_testConfiguration     = 1;    // Configuration Number for Loopback Test Interface
+    static constexpr unsigned   m_maxBulkTimeout        = 250;  // Ceiling for the adaptive Bulk Transfer Timeouts, in ms
+
+    Transport                   m_transport;
+    FixturePhases               m_phases;
+
+    libusb_context *            m_ctx;
+    libusb_device **            m_devs;
+    ssize_t                     m_devCnt;
+    libusb_device *             m_dutRef;
+
+    int                         m_activeConfiguration;
+
+    struct libusb_device_descriptor             m_deviceDescriptor;
+    const struct libusb_config_descriptor *     m_configDescriptor;
+    const struct libusb_interface_descriptor *  m_interfaceDescriptor;
+    bool                                        m_interfaceClaimed;
+
     libusb_device_handle *                      m_dutHandle;
     const struct libusb_endpoint_descriptor *   m_bulkOutEndpoint;
     const struct libusb_endpoint_descriptor *   m_bulkInEndpoint;
@@ -62,17 +74,438 @@ protected:
     unsigned                                    m_txTimeout;
     unsigned                                    m_rxTimeout;
 
+    /* DeviceWatchdog::transferErrors() when the Test started */
+    uint64_t                                    m_transferErrors;
+
+    /* Set-up Phases, in the Order libUsbInit() runs them */
+    void initContext(void);
+    void getDeviceList(void);
+    void findDevice(void);
+    void openDevice(void);
+    void activateDeviceConfiguration(void);
+    void fetchConfigDescriptor(void);
+    void parseConfigDescriptor(void);
+    void parseInterfaceDescriptor(void);
+    void claimInterface(void);
+
+    /* Untimed Parts of the Descriptor Parsing Phase, for Tests that re-parse Descriptors in their Body */
+    void findLoopbackInterface(void);
+    void findBulkEndpoints(void);
+
+    /* Runs the Set-up Phases; Fixtures that need fewer Phases override this */
+    virtual void libUsbInit(void);
+
+    /* Tear-down Phases, in the Order libUsbCleanUp() runs them */
+    void releaseInterface(void);
+    void freeConfigDescriptor(void);
+    void resetDeviceConfiguration(void);
+    void closeDevice(void);
+    void exitContext(void);
+
+    void libUsbCleanUp(void);
+
+    void checkDeviceHealth(void);
 
     void SetUp(void) override {
+        if (Transport::usesDevice() && DeviceWatchdog::dead()) {
+            GTEST_SKIP() << DeviceWatchdog::diagnosis();
+        }
+
+        m_transferErrors = DeviceWatchdog::transferErrors();
         libUsbInit();
     }
 
     void TearDown() override {
+        /* Everything between the last Set-up Phase and now was the Test Body */
+        m_phases.add(FixturePhases::Phase::Body, m_phases.lastEnd(), FixturePhases::Clock::now());
+
+        checkDeviceHealth();
         libUsbCleanUp();
+
+        m_phases.finish();
+    }
+
+    static void SetUpTestSuite(void) {
+        FixturePhases::beginSuite();
+    }
+
+    static void TearDownTestSuite(void) {
+        FixturePhases::endSuite(std::cout);
+    }
+
+    UsbDeviceTest(void)
+      : m_ctx(nullptr),
+        m_devs(nullptr),
+        m_devCnt(0),
+        m_dutRef(nullptr),
+        m_activeConfiguration(0),
+        m_configDescriptor(nullptr),
+        m_interfaceDescriptor(nullptr),
+        m_interfaceClaimed(false),
+        m_dutHandle(nullptr),
+        m_bulkOutEndpoint(nullptr),
+        m_bulkInEndpoint(nullptr),
+        m_maxBufferSz(0),
+        m_txTimeout(0),
+        m_rxTimeout(0),
+        m_transferErrors(0)
+    {
+
     }
 
-    UsbDeviceTest(void);
-    virtual ~UsbDeviceTest();
+    virtual ~UsbDeviceTest() {
+
+    }
 };
 
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::initContext(void) {
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::Init);
+
+    /* Initialize libusb Stack */
+    int rc = m_transport.init(&m_ctx);
+    ASSERT_EQ(LIBUSB_SUCCESS, rc) << "Failed to initialize libusb";
+    ASSERT_NE(nullptr, m_ctx);
+
+    m_transport.setOption(m_ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_INFO);
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::getDeviceList(void) {
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::DeviceScan);
+
+    m_devCnt = m_transport.getDeviceList(m_ctx, &m_devs);
+    ASSERT_GE(m_devCnt, 0) << __func__ << ": Failed to obtain the list of devices.";
+    ASSERT_NE(nullptr, m_devs);
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::findDevice(void) {
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::DeviceScan);
+
+    /* Find USB Device under Test */
+    for (ssize_t i = 0; (i < m_devCnt) && (m_dutRef == nullptr); i++) {
+        libusb_device_descriptor desc;
+        int rc = m_transport.getDeviceDescriptor(m_devs[i], &desc);
+        EXPECT_EQ(0, rc);
+
+        if ((desc.idVendor == m_vendorId) && (desc.idProduct == m_deviceId)) {
+            m_dutRef = m_transport.refDevice(m_devs[i]);
+        }
+    }
+    ASSERT_NE(nullptr, m_dutRef)
+      << "USB Device under Test not found! "
+      << "Expected VendorId=0x" << std::hex << m_vendorId
+      << " and DeviceId=0x" << std::hex << m_deviceId;
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::openDevice(void) {
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::Open);
+
+    ASSERT_NE(nullptr, m_dutRef);
+
+    int rc = m_transport.open(m_dutRef, &m_dutHandle);
+    ASSERT_EQ(0, rc);
+    ASSERT_NE(nullptr, m_dutHandle);
+
+    rc = m_transport.getDeviceDescriptor(m_dutRef, &m_deviceDescriptor);
+    ASSERT_EQ(0, rc) << "Failed to read Device Descriptor (rc=" << rc << ")";
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::activateDeviceConfiguration(void) {
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::SetConfiguration);
+
+    int rc;
+
+    rc = m_transport.getConfiguration(m_dutHandle, &m_activeConfiguration);
+    EXPECT_EQ(0, rc);
+
+    if (m_activeConfiguration == 0) {
+        rc = m_transport.setConfiguration(m_dutHandle, m_testConfiguration);
+        ASSERT_EQ(LIBUSB_SUCCESS, rc) << "Configuration '" << m_testConfiguration << "' could not be activated.";
+
+        rc = m_transport.getConfiguration(m_dutHandle, &m_activeConfiguration);
+        EXPECT_EQ(0, rc);
+    } else {
+        EXPECT_EQ(m_testConfiguration, m_activeConfiguration)
+          << "Expected USB Device to already be configured with Configuration '" << m_testConfiguration
+          << "' but Configuration '" << m_activeConfiguration << "' is already active.";
+    }
+
+    ASSERT_EQ(m_testConfiguration, m_activeConfiguration)
+      << "Expected USB Device Configuration '" << m_testConfiguration
+      << "', but Configuration '" << m_activeConfiguration << "' is active.";
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::fetchConfigDescriptor(void) {
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::DescriptorFetch);
+
+    /* Read the active Configuration's Descriptor */
+    ASSERT_NE(nullptr, m_dutRef);
+    ASSERT_NE(0, m_activeConfiguration) << "Expected USB Device to be configured";
+
+    int rc = m_transport.getActiveConfigDescriptor(m_dutRef, const_cast<libusb_config_descriptor **>(&m_configDescriptor));
+    ASSERT_EQ(0, rc) << "Failed to read Configuration Descriptor (rc=" << rc << ")";
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::parseConfigDescriptor(void) {
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::DescriptorParse);
+
+    findLoopbackInterface();
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::parseInterfaceDescriptor(void) {
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::DescriptorParse);
+
+    findBulkEndpoints();
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::findLoopbackInterface(void) {
+    m_interfaceDescriptor = nullptr;
+
+    ASSERT_EQ(m_activeConfiguration, m_configDescriptor->bConfigurationValue)
+      << "Expected Configuration #" << m_activeConfiguration
+      << " to be active but Device announced Configuration #" << m_configDescriptor->bConfigurationValue;
+
+    ASSERT_LT(0, m_configDescriptor->bNumInterfaces) << "Expected at least one interface in Device's Config Descriptor";
+    for (unsigned idx = 0; idx < m_configDescriptor->bNumInterfaces; idx++) {
+        const struct libusb_interface * const interface = m_configDescriptor->interface + idx;
+        EXPECT_LT(0, interface->num_altsetting);
+
+        const struct libusb_interface_descriptor * const interfaceDescriptor = interface->altsetting;
+        if ((interfaceDescriptor->bInterfaceClass == m_interfaceClass)
+          && (interfaceDescriptor->bInterfaceProtocol == m_interfaceProtocol)
+          && (interfaceDescriptor->bInterfaceSubClass == m_interfaceSubClass)) {
+              this->m_interfaceDescriptor = interfaceDescriptor;
+              break;
+        }
+    }
+    ASSERT_NE(nullptr, this->m_interfaceDescriptor);
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::findBulkEndpoints(void) {
+    m_bulkOutEndpoint = nullptr;
+    m_bulkInEndpoint = nullptr;
+
+    ASSERT_LT(0, m_interfaceDescriptor->bNumEndpoints)
+      << "Expected Device to have at least 2 Endpoints, but only found " << m_interfaceDescriptor->bNumEndpoints;
+    for (unsigned idx = 0;
+      (idx < m_interfaceDescriptor->bNumEndpoints) && ((nullptr == m_bulkInEndpoint) || (nullptr == m_bulkOutEndpoint));
+      idx++)
+    {
+        const struct libusb_endpoint_descriptor * const endpt = m_interfaceDescriptor->endpoint + idx;
+        ASSERT_NE(nullptr, endpt);
+
+        libusb_endpoint_direction dir = getEndpointDirection(*endpt);
+        libusb_transfer_type type = getEndpointType(*endpt);
+
+        if (type == LIBUSB_TRANSFER_TYPE_BULK) {
+            if (dir == LIBUSB_ENDPOINT_OUT) {
+                m_bulkOutEndpoint = endpt;
+            } else if (dir == LIBUSB_ENDPOINT_IN) {
+                m_bulkInEndpoint = endpt;
+            }
+        }
+    }
+    ASSERT_NE(nullptr, m_bulkOutEndpoint);
+    ASSERT_NE(nullptr, m_bulkInEndpoint);
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::claimInterface(void) {
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::Claim);
+
+    /* Claim the USB Device's Test Interface */
+    ASSERT_NE(nullptr, m_interfaceDescriptor) << "No valid Interface Descriptor found!";
+    int rc = m_transport.claimInterface(m_dutHandle, m_interfaceDescriptor->bInterfaceNumber);
+    ASSERT_EQ(0, rc) << "Failed to claim Interface " << m_interfaceDescriptor->bInterfaceNumber << "(rc=" << rc << ")";
+    m_interfaceClaimed = true;
+
+    /* TODO Query the Device's Characteristics */
+    m_maxBufferSz   = 2 * m_bulkOutEndpoint->wMaxPacketSize;
+    m_txTimeout     = DeviceWatchdog::timeout(UsbMetrics::Transfer::Bulk, m_maxBulkTimeout);
+    m_rxTimeout     = DeviceWatchdog::timeout(UsbMetrics::Transfer::Bulk, m_maxBulkTimeout);
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::libUsbInit(void) {
+    ASSERT_NO_FATAL_FAILURE(initContext());
+    ASSERT_NO_FATAL_FAILURE(getDeviceList());
+    ASSERT_NO_FATAL_FAILURE(findDevice());
+    ASSERT_NO_FATAL_FAILURE(openDevice());
+
+    /* Active USB Device's Test Configuration */
+    ASSERT_NO_FATAL_FAILURE(activateDeviceConfiguration());
+
+    /* Parse the USB Configuration Descriptor of Device's active Configuration */
+    ASSERT_NO_FATAL_FAILURE(fetchConfigDescriptor());
+    ASSERT_NO_FATAL_FAILURE(parseConfigDescriptor());
+    ASSERT_NO_FATAL_FAILURE(parseInterfaceDescriptor());
+
+    ASSERT_NO_FATAL_FAILURE(claimInterface());
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::checkDeviceHealth(void) {
+    if (!Transport::usesDevice() || DeviceWatchdog::dead() || (m_dutHandle == nullptr)) {
+        return;
+    }
+
+    /*
+     * Only failed Transfers warrant a Health Check, not a failed Assertion: A
+     * Replay serves the recorded Transfer Results, so it then runs the same Health
+     * Checks as the Recording, even if the Test's Host-side Checks differ.
+     */
+    if (DeviceWatchdog::transferErrors() == m_transferErrors) {
+        return;
+    }
+
+    /* A diverged Replay fails every Call; that says nothing about the Device */
+    if (LibUsb::diverged()) {
+        return;
+    }
+
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::HealthCheck);
+
+    uint8_t status[sizeof(uint16_t)];
+    int rc = m_transport.controlTransfer(m_dutHandle,
+        (1 << 7)    /* Direction: Device to Host */
+      | (0 << 5)    /* Type: Standard */
+      | (0 << 0),   /* Recipient: Device */
+      0x0,          /* bRequest = Get Status */
+      0x0,          /* wValue */
+      0x0,          /* wIndex */
+      status,
+      sizeof(status),
+      DeviceWatchdog::timeout(UsbMetrics::Transfer::Control, DeviceWatchdog::m_healthCheckTimeout)
+    );
+
+    if ((rc != sizeof(status)) && !LibUsb::diverged()) {
+        const ::testing::TestInfo * const test = ::testing::UnitTest::GetInstance()->current_test_info();
+
+        DeviceWatchdog::declareDead(std::string("No Answer to GET_STATUS after ")
+          + test->test_suite_name() + "." + test->name() + " had failed Transfers (rc=" + std::to_string(rc) + ").");
+    }
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::releaseInterface(void) {
+    /* Release the USB Device's Test Interface */
+    if (m_interfaceClaimed) {
+        FixturePhases::Scope scope(m_phases, FixturePhases::Phase::Release);
+
+        ASSERT_NE(nullptr, m_dutHandle);
+        int rc = m_transport.releaseInterface(m_dutHandle, m_interfaceDescriptor->bInterfaceNumber);
+        EXPECT_EQ(0, rc);
+    }
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::freeConfigDescriptor(void) {
+    /* Free the USB Configuration Descriptor */
+    if (nullptr != m_configDescriptor) {
+        FixturePhases::Scope scope(m_phases, FixturePhases::Phase::DescriptorFree);
+
+        m_transport.freeConfigDescriptor(const_cast<libusb_config_descriptor *>(m_configDescriptor));
+    }
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::resetDeviceConfiguration(void) {
+    int cfgNum, rc;
+
+    /* A dead Device would only make SET_CONFIGURATION wait for its Timeout */
+    if (!m_activeConfiguration || (Transport::usesDevice() && DeviceWatchdog::dead())) {
+        return;
+    }
+
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::Deconfigure);
+
+    rc = m_transport.getConfiguration(m_dutHandle, &cfgNum);
+    EXPECT_EQ(0, rc);
+
+    ASSERT_EQ(m_activeConfiguration, cfgNum) << "Expected USB Device Configuration '" << m_activeConfiguration << "', but Configuration '" << cfgNum << "' is active.";
+
+    /*
+    * libusb Documentation says that -1 should be used to re-set the device configuration
+    * because buggy USB devices may actually have a configuration #0. Unfortunately, I
+    * found that this crashes (on macOS).
+    *
+    * Since we're testing a device that should handle the configuration according to the
+    * USB standard, this fear should not apply.
+    */
+    rc = m_transport.setConfiguration(m_dutHandle, -1);
+    EXPECT_EQ(LIBUSB_SUCCESS, rc) << "Configuration could not be de-activated.";
+
+    rc = m_transport.getConfiguration(m_dutHandle, &cfgNum);
+    EXPECT_EQ(0, rc);
+
+    ASSERT_EQ(0, cfgNum) << "Expected USB Device Configuration '0', but Configuration '" << cfgNum << "' is active.";
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::closeDevice(void) {
+    FixturePhases::Scope scope(m_phases, FixturePhases::Phase::Close);
+
+    if (m_dutHandle != nullptr) {
+        m_transport.close(m_dutHandle);
+    }
+
+    if (m_dutRef != nullptr) {
+        m_transport.unrefDevice(m_dutRef);
+    }
+
+    if (m_devs != nullptr) {
+        m_transport.freeDeviceList(m_devs, 1);
+    }
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::exitContext(void) {
+    /* Tear-down libusb Stack */
+    if (m_ctx != nullptr) {
+        FixturePhases::Scope scope(m_phases, FixturePhases::Phase::Exit);
+
+        m_transport.exit(m_ctx);
+    }
+}
+
+template<typename Transport>
+void
+UsbDeviceTest<Transport>::libUsbCleanUp(void) {
+    releaseInterface();
+    freeConfigDescriptor();
+
+    /* Reset the USB Device's Configuration / Reset the Device to the "unconfigured" state */
+    resetDeviceConfiguration();
+
+    closeDevice();
+    exitContext();
+}
+
 #endif /* USB_DEVICE_TEST_HPP_C208FB0A_33A0_411C_91B3_F19C78ECCBA0 */
@@ -0,0 +1,263 @@
+/*-
+ * $Copyright$
+ */
+
+#include "UsbMetrics.hpp"
+
+#include <libusb-1.0/libusb.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+std::atomic<bool>                           UsbMetrics::m_enabled(false);
+std::atomic<UsbMetrics::ThreadCounters *>   UsbMetrics::m_threads(nullptr);
+thread_local UsbMetrics::ThreadSlot         UsbMetrics::m_threadSlot = { nullptr };
+std::string                                 UsbMetrics::m_path;
+std::chrono::milliseconds                   UsbMetrics::m_interval;
+std::thread                                 UsbMetrics::m_exporter;
+std::mutex                                  UsbMetrics::m_mutex;
+std::condition_variable                     UsbMetrics::m_wakeup;
+bool                                        UsbMetrics::m_stop = false;
+
+/* Counters have a single Writer, so a Read-Modify-Write does not need to be atomic */
+static inline void
+add(std::atomic<uint64_t> &p_counter, uint64_t p_value) {
+    p_counter.store(p_counter.load(std::memory_order_relaxed) + p_value, std::memory_order_relaxed);
+}
+
+bool
+UsbMetrics::start(const std::string &p_path, std::chrono::milliseconds p_interval, std::string &p_error) {
+    m_path = p_path;
+    m_interval = p_interval;
+    m_stop = false;
+
+    /* Fail early if the File cannot be written */
+    Snapshot empty {};
+    if (!write(empty, empty, std::chrono::nanoseconds::zero())) {
+        p_error = "Cannot write Metrics File '" + p_path + "': " + ::strerror(errno);
+        return false;
+    }
+
+    m_enabled.store(true, std::memory_order_relaxed);
+    m_exporter = std::thread(run);
+
+    return true;
+}
+
+void
+UsbMetrics::stop(void) {
+    if (!m_exporter.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeup.notify_all();
+    m_exporter.join();
+
+    m_enabled.store(false, std::memory_order_relaxed);
+}
+
+UsbMetrics::ThreadSlot::~ThreadSlot() {
+    if (m_counters != nullptr) {
+        /* Publishes the last Updates to the next Owner */
+        m_counters->m_inUse.store(false, std::memory_order_release);
+    }
+}
+
+UsbMetrics::ThreadCounters &
+UsbMetrics::threadCounters(void) {
+    if (m_threadSlot.m_counters != nullptr) {
+        return *m_threadSlot.m_counters;
+    }
+
+    /* Take over the Counters of an exited Thread; they are Totals, so the new Owner just keeps adding */
+    for (ThreadCounters *c = m_threads.load(std::memory_order_acquire); c != nullptr; c = c->m_next) {
+        bool inUse = false;
+
+        if (c->m_inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire, std::memory_order_relaxed)) {
+            m_threadSlot.m_counters = c;
+            return *c;
+        }
+    }
+
+    ThreadCounters * const counters = new ThreadCounters();
+    counters->m_inUse.store(true, std::memory_order_relaxed);
+
+    counters->m_next = m_threads.load(std::memory_order_relaxed);
+    while (!m_threads.compare_exchange_weak(counters->m_next, counters, std::memory_order_release, std::memory_order_relaxed)) {
+        /* Retry with updated m_next */
+    }
+
+    m_threadSlot.m_counters = counters;
+
+    return *counters;
+}
+
+size_t
+UsbMetrics::bucket(uint64_t p_nanoseconds) {
+    if (p_nanoseconds < 4) {
+        return p_nanoseconds;
+    }
+
+    const unsigned msb = 63 - __builtin_clzll(p_nanoseconds);
+    const unsigned sub = (p_nanoseconds >> (msb - 2)) & 3;
+
+    return std::min<size_t>(4 * (msb - 1) + sub, m_numBuckets - 1);
+}
+
+uint64_t
+UsbMetrics::bucketUpperBound(size_t p_bucket) {
+    if (p_bucket < 4) {
+        return p_bucket;
+    }
+
+    const unsigned msb = (p_bucket / 4) + 1;
+    const unsigned sub = p_bucket % 4;
+
+    return ((static_cast<uint64_t>(5 + sub) << (msb - 2)) - 1);
+}
+
+void
+UsbMetrics::count(Transfer p_type, bool p_in, size_t p_bytes, int p_status, std::chrono::nanoseconds p_latency) {
+    ThreadCounters &counters = threadCounters();
+
+    add(counters.m_transfers[static_cast<unsigned>(p_type)], 1);
+    add(p_in ? counters.m_bytesIn : counters.m_bytesOut, p_bytes);
+
+    if (p_status < 0) {
+        add(counters.m_errors, 1);
+        if (p_status == LIBUSB_ERROR_TIMEOUT) {
+            add(counters.m_timeouts, 1);
+        }
+    }
+
+    const uint64_t latency = std::max<int64_t>(p_latency.count(), 0);
+    add(counters.m_latencySum, latency);
+    add(counters.m_latency[bucket(latency)], 1);
+}
+
+void
+UsbMetrics::snapshot(Snapshot &p_snapshot) {
+    p_snapshot = Snapshot {};
+
+    for (const ThreadCounters *c = m_threads.load(std::memory_order_acquire); c != nullptr; c = c->m_next) {
+        p_snapshot.m_transfers[0]   += c->m_transfers[0].load(std::memory_order_relaxed);
+        p_snapshot.m_transfers[1]   += c->m_transfers[1].load(std::memory_order_relaxed);
+        p_snapshot.m_bytesIn        += c->m_bytesIn.load(std::memory_order_relaxed);
+        p_snapshot.m_bytesOut       += c->m_bytesOut.load(std::memory_order_relaxed);
+        p_snapshot.m_errors         += c->m_errors.load(std::memory_order_relaxed);
+        p_snapshot.m_timeouts       += c->m_timeouts.load(std::memory_order_relaxed);
+        p_snapshot.m_latencySum     += c->m_latencySum.load(std::memory_order_relaxed);
+        for (size_t idx = 0; idx < m_numBuckets; idx++) {
+            p_snapshot.m_latency[idx] += c->m_latency[idx].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool
+UsbMetrics::write(const Snapshot &p_current, const Snapshot &p_previous, std::chrono::nanoseconds p_elapsed) {
+    const std::string tmpPath = m_path + ".tmp";
+    std::ofstream os(tmpPath, std::ios::trunc);
+
+    if (!os) {
+        return false;
+    }
+
+    const double elapsed = std::chrono::duration<double>(p_elapsed).count();
+    const uint64_t bytes = (p_current.m_bytesIn + p_current.m_bytesOut) - (p_previous.m_bytesIn + p_previous.m_bytesOut);
+
+    /* Latency Quantiles over the last Interval */
+    uint64_t window[m_numBuckets];
+    uint64_t windowCount = 0;
+    for (size_t idx = 0; idx < m_numBuckets; idx++) {
+        window[idx] = p_current.m_latency[idx] - p_previous.m_latency[idx];
+        windowCount += window[idx];
+    }
+
+    os << std::setprecision(9);
+
+    os << "# HELP usbdevice_transfers_total Number of USB Transfers." << std::endl
+      << "# TYPE usbdevice_transfers_total counter" << std::endl
+      << "usbdevice_transfers_total{type=\"control\"} " << p_current.m_transfers[static_cast<unsigned>(Transfer::Control)] << std::endl
+      << "usbdevice_transfers_total{type=\"bulk\"} " << p_current.m_transfers[static_cast<unsigned>(Transfer::Bulk)] << std::endl;
+
+    os << "# HELP usbdevice_transfer_bytes_total Number of Bytes moved." << std::endl
+      << "# TYPE usbdevice_transfer_bytes_total counter" << std::endl
+      << "usbdevice_transfer_bytes_total{direction=\"in\"} " << p_current.m_bytesIn << std::endl
+      << "usbdevice_transfer_bytes_total{direction=\"out\"} " << p_current.m_bytesOut << std::endl;
+
+    os << "# HELP usbdevice_transfer_errors_total Number of failed USB Transfers, including Timeouts." << std::endl
+      << "# TYPE usbdevice_transfer_errors_total counter" << std::endl
+      << "usbdevice_transfer_errors_total " << p_current.m_errors << std::endl;
+
+    os << "# HELP usbdevice_transfer_timeouts_total Number of timed out USB Transfers." << std::endl
+      << "# TYPE usbdevice_transfer_timeouts_total counter" << std::endl
+      << "usbdevice_transfer_timeouts_total " << p_current.m_timeouts << std::endl;
+
+    os << "# HELP usbdevice_throughput_bytes_per_second Bytes moved per Second over the last Interval." << std::endl
+      << "# TYPE usbdevice_throughput_bytes_per_second gauge" << std::endl
+      << "usbdevice_throughput_bytes_per_second " << ((elapsed > 0) ? (bytes / elapsed) : 0.0) << std::endl;
+
+    os << "# HELP usbdevice_transfer_latency_seconds USB Transfer Latency; Quantiles over the last Interval." << std::endl
+      << "# TYPE usbdevice_transfer_latency_seconds summary" << std::endl;
+    for (const double quantile : { 0.5, 0.9, 0.99, 0.999 }) {
+        os << "usbdevice_transfer_latency_seconds{quantile=\"" << quantile << "\"} ";
+
+        if (windowCount == 0) {
+            os << "NaN" << std::endl;
+            continue;
+        }
+
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * windowCount)));
+        uint64_t cumulative = 0;
+        size_t idx = 0;
+        for (; idx < m_numBuckets; idx++) {
+            cumulative += window[idx];
+            if (cumulative >= rank) {
+                break;
+            }
+        }
+        os << (bucketUpperBound(idx) / 1e9) << std::endl;
+    }
+    os << "usbdevice_transfer_latency_seconds_sum " << (p_current.m_latencySum / 1e9) << std::endl
+      << "usbdevice_transfer_latency_seconds_count " << (p_current.m_transfers[0] + p_current.m_transfers[1]) << std::endl;
+
+    os.close();
+
+    if (!os) {
+        return false;
+    }
+
+    return (std::rename(tmpPath.c_str(), m_path.c_str()) == 0);
+}
+
+void
+UsbMetrics::run(void) {
+    Snapshot current {}, previous {};
+    std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+    bool stop = false;
+
+    while (!stop) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeup.wait_for(lock, m_interval, [] { return m_stop; });
+            stop = m_stop;
+        }
+
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        snapshot(current);
+        write(current, previous, now - last);
+
+        previous = current;
+        last = now;
+    }
+}
@@ -0,0 +1,108 @@
+/*-
+ * $Copyright$
+ */
+
+#ifndef USB_METRICS_HPP_6C4D0B92_71E3_4A85_BF26_3E9A57D1C0F4
+#define USB_METRICS_HPP_6C4D0B92_71E3_4A85_BF26_3E9A57D1C0F4
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ * Live Metrics for long-running Benchmark and Soak Runs.
+ *
+ * Every Transfer issued through LibUsb is counted in Counters owned by the
+ * calling Thread. Only the owning Thread writes its Counters, so updates are
+ * plain relaxed atomic Stores without any Locking. When a Thread exits, its
+ * Counters are handed on to the next new Thread, which keeps adding to them;
+ * so the Number of Counters is bounded by the Number of concurrent Threads. An Exporter Thread
+ * periodically sums up the Counters of all Threads and rewrites a File in the
+ * Prometheus Text Format (Version 0.0.4), e.g. for the node_exporter's Textfile
+ * Collector. The File is replaced atomically, so a Scraper never sees a partial
+ * File.
+ *
+ * Latencies are counted in a log-linear Histogram (four Buckets per Power of
+ * two Nanoseconds); the exported Quantiles cover the last Export Interval.
+ */
+class UsbMetrics {
+public:
+    enum class Transfer {
+        Control,
+        Bulk
+    };
+
+    static bool start(const std::string &p_path, std::chrono::milliseconds p_interval, std::string &p_error);
+    static void stop(void);
+
+    static bool enabled(void) { return m_enabled.load(std::memory_order_relaxed); }
+
+    /* p_status is the libusb Return Code; p_bytes the Number of Bytes actually transferred */
+    static void transfer(Transfer p_type, bool p_in, size_t p_bytes, int p_status, std::chrono::nanoseconds p_latency) {
+        if (enabled()) {
+            count(p_type, p_in, p_bytes, p_status, p_latency);
+        }
+    }
+
+    static constexpr size_t m_numBuckets = 4 * 63;
+
+private:
+    struct ThreadCounters {
+        std::atomic<uint64_t>   m_transfers[2];
+        std::atomic<uint64_t>   m_bytesIn;
+        std::atomic<uint64_t>   m_bytesOut;
+        std::atomic<uint64_t>   m_errors;
+        std::atomic<uint64_t>   m_timeouts;
+        std::atomic<uint64_t>   m_latencySum;
+        std::atomic<uint64_t>   m_latency[m_numBuckets];
+        std::atomic<bool>       m_inUse;
+        ThreadCounters *        m_next;
+    };
+
+    /* Releases the Thread's Counters for Re-use when the Thread exits */
+    struct ThreadSlot {
+        ThreadCounters *        m_counters;
+
+        ~ThreadSlot();
+    };
+
+    struct Snapshot {
+        uint64_t                m_transfers[2];
+        uint64_t                m_bytesIn;
+        uint64_t                m_bytesOut;
+        uint64_t                m_errors;
+        uint64_t                m_timeouts;
+        uint64_t                m_latencySum;
+        uint64_t                m_latency[m_numBuckets];
+    };
+
+    static std::atomic<bool>                m_enabled;
+
+    /* Lock-free List of all Threads' Counters. Entries are never removed, but re-used. */
+    static std::atomic<ThreadCounters *>    m_threads;
+    static thread_local ThreadSlot          m_threadSlot;
+
+    static std::string                      m_path;
+    static std::chrono::milliseconds        m_interval;
+    static std::thread                      m_exporter;
+    static std::mutex                       m_mutex;
+    static std::condition_variable          m_wakeup;
+    static bool                             m_stop;
+
+    static void count(Transfer p_type, bool p_in, size_t p_bytes, int p_status, std::chrono::nanoseconds p_latency);
+    static ThreadCounters & threadCounters(void);
+
+    static size_t   bucket(uint64_t p_nanoseconds);
+    static uint64_t bucketUpperBound(size_t p_bucket);
+
+    static void snapshot(Snapshot &p_snapshot);
+    static bool write(const Snapshot &p_current, const Snapshot &p_previous, std::chrono::nanoseconds p_elapsed);
+    static void run(void);
+};
+
+#endif /* USB_METRICS_HPP_6C4D0B92_71E3_4A85_BF26_3E9A57D1C0F4 */
@@ -0,0 +1,245 @@
+/*-
+ * $Copyright$
+ */
+
+#include "UsbTransport.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+std::mutex              InMemoryTransport::m_mutex;
+int                     InMemoryTransport::m_configuration      = 0;
+unsigned                InMemoryTransport::m_claimedInterfaces  = 0;
+bool                    InMemoryTransport::m_open               = false;
+std::deque<uint8_t>     InMemoryTransport::m_fifo;
+char                    InMemoryTransport::m_context;
+char                    InMemoryTransport::m_device;
+char                    InMemoryTransport::m_handle;
+
+const struct libusb_device_descriptor InMemoryTransport::m_deviceDescriptor = {
+    18,                         /* bLength */
+    0x01,                       /* bDescriptorType = Device */
+    0x0200,                     /* bcdUSB */
+    0x00,                       /* bDeviceClass = per Interface */
+    0x00,                       /* bDeviceSubClass */
+    0x00,                       /* bDeviceProtocol */
+    64,                         /* bMaxPacketSize0 */
+    0xdead,                     /* idVendor */
+    0xbeef,                     /* idProduct */
+    0x0100,                     /* bcdDevice */
+    0,                          /* iManufacturer */
+    0,                          /* iProduct */
+    0,                          /* iSerialNumber */
+    1                           /* bNumConfigurations */
+};
+
+const struct libusb_endpoint_descriptor InMemoryTransport::m_loopbackEndpoints[2] = {
+    /* bLength, bDescriptorType, bEndpointAddress, bmAttributes, wMaxPacketSize, bInterval, bRefresh, bSynchAddress, extra, extra_length */
+    { 7, 0x05, 0x01, LIBUSB_TRANSFER_TYPE_BULK, 64, 0, 0, 0, nullptr, 0 },
+    { 7, 0x05, 0x81, LIBUSB_TRANSFER_TYPE_BULK, 64, 0, 0, 0, nullptr, 0 },
+};
+
+const struct libusb_interface_descriptor InMemoryTransport::m_interfaceDescriptors[2] = {
+    /* bLength, bDescriptorType, bInterfaceNumber, bAlternateSetting, bNumEndpoints, bInterfaceClass, bInterfaceSubClass, bInterfaceProtocol, iInterface, endpoint, extra, extra_length */
+    { 9, 0x04, 0, 0, 0, LIBUSB_CLASS_VENDOR_SPEC, 0x00, 0x00, 0, nullptr, nullptr, 0 },
+    { 9, 0x04, 1, 0, 2, LIBUSB_CLASS_VENDOR_SPEC, 0x10, 0x0B, 0, m_loopbackEndpoints, nullptr, 0 },
+};
+
+const struct libusb_interface InMemoryTransport::m_interfaces[2] = {
+    { &m_interfaceDescriptors[0], 1 },
+    { &m_interfaceDescriptors[1], 1 },
+};
+
+const struct libusb_config_descriptor InMemoryTransport::m_configDescriptor = {
+    9,                          /* bLength */
+    0x02,                       /* bDescriptorType = Configuration */
+    9 + 9 + 9 + 7 + 7,          /* wTotalLength */
+    2,                          /* bNumInterfaces */
+    1,                          /* bConfigurationValue */
+    0,                          /* iConfiguration */
+    0x80,                       /* bmAttributes = Bus powered */
+    50,                         /* MaxPower = 100mA */
+    m_interfaces,
+    nullptr,
+    0
+};
+
+const size_t InMemoryTransport::m_fifoSz = 2 * 64;
+
+int
+InMemoryTransport::init(libusb_context **p_ctx) {
+    *p_ctx = reinterpret_cast<libusb_context *>(&m_context);
+    return LIBUSB_SUCCESS;
+}
+
+void
+InMemoryTransport::exit(libusb_context * /* p_ctx */) {
+
+}
+
+int
+InMemoryTransport::setOption(libusb_context * /* p_ctx */, enum libusb_option /* p_option */, int /* p_value */) {
+    return LIBUSB_SUCCESS;
+}
+
+ssize_t
+InMemoryTransport::getDeviceList(libusb_context * /* p_ctx */, libusb_device ***p_list) {
+    *p_list = new libusb_device *[2];
+    (*p_list)[0] = reinterpret_cast<libusb_device *>(&m_device);
+    (*p_list)[1] = nullptr;
+
+    return 1;
+}
+
+void
+InMemoryTransport::freeDeviceList(libusb_device **p_list, int /* p_unrefDevices */) {
+    delete[] p_list;
+}
+
+libusb_device *
+InMemoryTransport::refDevice(libusb_device *p_device) {
+    return p_device;
+}
+
+void
+InMemoryTransport::unrefDevice(libusb_device * /* p_device */) {
+
+}
+
+int
+InMemoryTransport::getDeviceDescriptor(libusb_device * /* p_device */, struct libusb_device_descriptor *p_descriptor) {
+    *p_descriptor = m_deviceDescriptor;
+    return LIBUSB_SUCCESS;
+}
+
+int
+InMemoryTransport::getActiveConfigDescriptor(libusb_device * /* p_device */, struct libusb_config_descriptor **p_config) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_configuration != m_configDescriptor.bConfigurationValue) {
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+
+    *p_config = const_cast<struct libusb_config_descriptor *>(&m_configDescriptor);
+    return LIBUSB_SUCCESS;
+}
+
+void
+InMemoryTransport::freeConfigDescriptor(struct libusb_config_descriptor * /* p_config */) {
+
+}
+
+int
+InMemoryTransport::open(libusb_device * /* p_device */, libusb_device_handle **p_handle) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_open = true;
+    *p_handle = reinterpret_cast<libusb_device_handle *>(&m_handle);
+
+    return LIBUSB_SUCCESS;
+}
+
+void
+InMemoryTransport::close(libusb_device_handle * /* p_handle */) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    /* Like libusb, release all Interfaces still claimed through the Handle */
+    m_claimedInterfaces = 0;
+    m_open = false;
+}
+
+int
+InMemoryTransport::getConfiguration(libusb_device_handle * /* p_handle */, int *p_configuration) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    *p_configuration = m_configuration;
+    return LIBUSB_SUCCESS;
+}
+
+int
+InMemoryTransport::setConfiguration(libusb_device_handle * /* p_handle */, int p_configuration) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_claimedInterfaces != 0) {
+        return LIBUSB_ERROR_BUSY;
+    }
+
+    if ((p_configuration != -1) && (p_configuration != 0) && (p_configuration != m_configDescriptor.bConfigurationValue)) {
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+
+    m_configuration = std::max(p_configuration, 0);
+    m_fifo.clear();
+
+    return LIBUSB_SUCCESS;
+}
+
+int
+InMemoryTransport::claimInterface(libusb_device_handle * /* p_handle */, int p_interface) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if ((m_configuration == 0) || (p_interface < 0) || (p_interface >= m_configDescriptor.bNumInterfaces)) {
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+
+    m_claimedInterfaces |= (1u << p_interface);
+    return LIBUSB_SUCCESS;
+}
+
+int
+InMemoryTransport::releaseInterface(libusb_device_handle * /* p_handle */, int p_interface) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if ((p_interface < 0) || ((m_claimedInterfaces & (1u << p_interface)) == 0)) {
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+
+    m_claimedInterfaces &= ~(1u << p_interface);
+    return LIBUSB_SUCCESS;
+}
+
+int
+InMemoryTransport::controlTransfer(libusb_device_handle * /* p_handle */, uint8_t p_requestType, uint8_t p_request,
+  uint16_t /* p_value */, uint16_t /* p_index */, unsigned char *p_data, uint16_t p_length, unsigned /* p_timeout */)
+{
+    /* Only Standard GET_STATUS to the Device is supported; everything else stalls */
+    if ((p_requestType == 0x80) && (p_request == 0x00)) {
+        const uint16_t length = std::min<uint16_t>(p_length, sizeof(uint16_t));
+        ::memset(p_data, 0, length);
+        return length;
+    }
+
+    return LIBUSB_ERROR_PIPE;
+}
+
+int
+InMemoryTransport::bulkTransfer(libusb_device_handle * /* p_handle */, unsigned char p_endpoint, unsigned char *p_data,
+  int p_length, int *p_transferred, unsigned /* p_timeout */)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    *p_transferred = 0;
+
+    /* Loopback Interface is #1 */
+    if ((m_configuration == 0) || ((m_claimedInterfaces & (1u << 1)) == 0)) {
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+
+    if (p_endpoint == m_loopbackEndpoints[0].bEndpointAddress) {
+        /* Device NAKs once its FIFO is full */
+        const size_t length = std::min<size_t>(p_length, m_fifoSz - m_fifo.size());
+        m_fifo.insert(m_fifo.end(), p_data, p_data + length);
+        *p_transferred = length;
+
+        return (length == static_cast<size_t>(p_length)) ? LIBUSB_SUCCESS : LIBUSB_ERROR_TIMEOUT;
+    } else if (p_endpoint == m_loopbackEndpoints[1].bEndpointAddress) {
+        const size_t length = std::min<size_t>(p_length, m_fifo.size());
+        std::copy_n(m_fifo.begin(), length, p_data);
+        m_fifo.erase(m_fifo.begin(), m_fifo.begin() + length);
+        *p_transferred = length;
+
+        return (length > 0) ? LIBUSB_SUCCESS : LIBUSB_ERROR_TIMEOUT;
+    }
+
+    return LIBUSB_ERROR_NOT_FOUND;
+}
@@ -0,0 +1,222 @@
+/*-
+ * $Copyright$
+ */
+
+#ifndef USB_TRANSPORT_HPP_B7F2A4C9_0E61_4D3A_8C5B_92D1E6F037A8
+#define USB_TRANSPORT_HPP_B7F2A4C9_0E61_4D3A_8C5B_92D1E6F037A8
+
+#include <libusb-1.0/libusb.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "LibUsb.hpp"
+
+/*
+ * Transport Policies for the Test Fixtures.
+ *
+ * The Fixtures are templated on a Transport and call all libusb Functions
+ * through an instance of it. Calls are resolved at compile time, so there is
+ * no abstraction overhead on the Transfer path. Every Transport provides the
+ * same set of Methods, named after the libusb Functions they replace:
+ *
+ *  - SyncLibUsbTransport uses libusb's synchronous API (via LibUsb).
+ *  - AsyncLibUsbTransport uses libusb's asynchronous API for Transfers.
+ *  - InMemoryTransport simulates the Loopback Device without any USB Hardware.
+ */
+class SyncLibUsbTransport {
+public:
+    static const char * name(void) { return "Sync"; }
+
+    /* Whether Tests through this Transport need the USB Device, see DeviceWatchdog */
+    static bool usesDevice(void) { return true; }
+
+    int init(libusb_context **p_ctx) {
+        return LibUsb::init(p_ctx);
+    }
+
+    void exit(libusb_context *p_ctx) {
+        LibUsb::exit(p_ctx);
+    }
+
+    int setOption(libusb_context *p_ctx, enum libusb_option p_option, int p_value) {
+        return LibUsb::setOption(p_ctx, p_option, p_value);
+    }
+
+    ssize_t getDeviceList(libusb_context *p_ctx, libusb_device ***p_list) {
+        return LibUsb::getDeviceList(p_ctx, p_list);
+    }
+
+    void freeDeviceList(libusb_device **p_list, int p_unrefDevices) {
+        LibUsb::freeDeviceList(p_list, p_unrefDevices);
+    }
+
+    libusb_device * refDevice(libusb_device *p_device) {
+        return LibUsb::refDevice(p_device);
+    }
+
+    void unrefDevice(libusb_device *p_device) {
+        LibUsb::unrefDevice(p_device);
+    }
+
+    int getDeviceDescriptor(libusb_device *p_device, struct libusb_device_descriptor *p_descriptor) {
+        return LibUsb::getDeviceDescriptor(p_device, p_descriptor);
+    }
+
+    int getActiveConfigDescriptor(libusb_device *p_device, struct libusb_config_descriptor **p_config) {
+        return LibUsb::getActiveConfigDescriptor(p_device, p_config);
+    }
+
+    void freeConfigDescriptor(struct libusb_config_descriptor *p_config) {
+        LibUsb::freeConfigDescriptor(p_config);
+    }
+
+    int open(libusb_device *p_device, libusb_device_handle **p_handle) {
+        return LibUsb::open(p_device, p_handle);
+    }
+
+    void close(libusb_device_handle *p_handle) {
+        LibUsb::close(p_handle);
+    }
+
+    int getConfiguration(libusb_device_handle *p_handle, int *p_configuration) {
+        return LibUsb::getConfiguration(p_handle, p_configuration);
+    }
+
+    int setConfiguration(libusb_device_handle *p_handle, int p_configuration) {
+        return LibUsb::setConfiguration(p_handle, p_configuration);
+    }
+
+    int claimInterface(libusb_device_handle *p_handle, int p_interface) {
+        return LibUsb::claimInterface(p_handle, p_interface);
+    }
+
+    int releaseInterface(libusb_device_handle *p_handle, int p_interface) {
+        return LibUsb::releaseInterface(p_handle, p_interface);
+    }
+
+    int controlTransfer(libusb_device_handle *p_handle, uint8_t p_requestType, uint8_t p_request,
+      uint16_t p_value, uint16_t p_index, unsigned char *p_data, uint16_t p_length, unsigned p_timeout)
+    {
+        return LibUsb::controlTransfer(p_handle, p_requestType, p_request, p_value, p_index, p_data, p_length, p_timeout);
+    }
+
+    int bulkTransfer(libusb_device_handle *p_handle, unsigned char p_endpoint, unsigned char *p_data,
+      int p_length, int *p_transferred, unsigned p_timeout)
+    {
+        return LibUsb::bulkTransfer(p_handle, p_endpoint, p_data, p_length, p_transferred, p_timeout);
+    }
+};
+
+class AsyncLibUsbTransport : public SyncLibUsbTransport {
+    libusb_context *    m_ctx;
+
+public:
+    static const char * name(void) { return "Async"; }
+
+    AsyncLibUsbTransport(void) : m_ctx(nullptr) {
+
+    }
+
+    int init(libusb_context **p_ctx) {
+        int rc = SyncLibUsbTransport::init(p_ctx);
+        m_ctx = (rc == LIBUSB_SUCCESS) ? *p_ctx : nullptr;
+        return rc;
+    }
+
+    void exit(libusb_context *p_ctx) {
+        SyncLibUsbTransport::exit(p_ctx);
+        m_ctx = nullptr;
+    }
+
+    int controlTransfer(libusb_device_handle *p_handle, uint8_t p_requestType, uint8_t p_request,
+      uint16_t p_value, uint16_t p_index, unsigned char *p_data, uint16_t p_length, unsigned p_timeout)
+    {
+        return LibUsb::controlTransferAsync(m_ctx, p_handle, p_requestType, p_request, p_value, p_index, p_data, p_length, p_timeout);
+    }
+
+    int bulkTransfer(libusb_device_handle *p_handle, unsigned char p_endpoint, unsigned char *p_data,
+      int p_length, int *p_transferred, unsigned p_timeout)
+    {
+        return LibUsb::bulkTransferAsync(m_ctx, p_handle, p_endpoint, p_data, p_length, p_transferred, p_timeout);
+    }
+};
+
+/*
+ * Simulates the Loopback Device of stm32f4-usbdevice: a single Configuration
+ * with a Loopback Interface whose Bulk OUT Endpoint feeds a FIFO of two Packets
+ * that is drained through the Bulk IN Endpoint.
+ *
+ * Like a real Device, the simulated Device's State is shared by all Instances
+ * and persists across Tests.
+ */
+class InMemoryTransport {
+    static std::mutex                                   m_mutex;
+    static int                                          m_configuration;
+    static unsigned                                     m_claimedInterfaces;
+    static bool                                         m_open;
+    static std::deque<uint8_t>                          m_fifo;
+
+    static const struct libusb_device_descriptor        m_deviceDescriptor;
+    static const struct libusb_endpoint_descriptor      m_loopbackEndpoints[2];
+    static const struct libusb_interface_descriptor     m_interfaceDescriptors[2];
+    static const struct libusb_interface                m_interfaces[2];
+    static const struct libusb_config_descriptor        m_configDescriptor;
+    static const size_t                                 m_fifoSz;
+
+    /* Stand-ins for the opaque libusb Objects */
+    static char                                         m_context;
+    static char                                         m_device;
+    static char                                         m_handle;
+
+public:
+    static const char * name(void) { return "InMemory"; }
+    static bool usesDevice(void) { return false; }
+
+    int     init(libusb_context **p_ctx);
+    void    exit(libusb_context *p_ctx);
+    int     setOption(libusb_context *p_ctx, enum libusb_option p_option, int p_value);
+
+    ssize_t getDeviceList(libusb_context *p_ctx, libusb_device ***p_list);
+    void    freeDeviceList(libusb_device **p_list, int p_unrefDevices);
+    libusb_device * refDevice(libusb_device *p_device);
+    void    unrefDevice(libusb_device *p_device);
+
+    int     getDeviceDescriptor(libusb_device *p_device, struct libusb_device_descriptor *p_descriptor);
+    int     getActiveConfigDescriptor(libusb_device *p_device, struct libusb_config_descriptor **p_config);
+    void    freeConfigDescriptor(struct libusb_config_descriptor *p_config);
+
+    int     open(libusb_device *p_device, libusb_device_handle **p_handle);
+    void    close(libusb_device_handle *p_handle);
+
+    int     getConfiguration(libusb_device_handle *p_handle, int *p_configuration);
+    int     setConfiguration(libusb_device_handle *p_handle, int p_configuration);
+    int     claimInterface(libusb_device_handle *p_handle, int p_interface);
+    int     releaseInterface(libusb_device_handle *p_handle, int p_interface);
+
+    int     controlTransfer(libusb_device_handle *p_handle, uint8_t p_requestType, uint8_t p_request,
+              uint16_t p_value, uint16_t p_index, unsigned char *p_data, uint16_t p_length, unsigned p_timeout);
+    int     bulkTransfer(libusb_device_handle *p_handle, unsigned char p_endpoint, unsigned char *p_data,
+              int p_length, int *p_transferred, unsigned p_timeout);
+};
+
+/*
+ * Type List and Names for TYPED_TEST_SUITE(), e.g.
+ *
+ *   TYPED_TEST_SUITE(BulkTransferTest, UsbTransports, UsbTransportNames);
+ */
+typedef ::testing::Types<SyncLibUsbTransport, AsyncLibUsbTransport, InMemoryTransport> UsbTransports;
+
+class UsbTransportNames {
+public:
+    template<typename Transport>
+    static std::string GetName(int /* p_index */) {
+        return Transport::name();
+    }
+};
+
+#endif /* USB_TRANSPORT_HPP_B7F2A4C9_0E61_4D3A_8C5B_92D1E6F037A8 */
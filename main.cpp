@@ -4,12 +4,105 @@
 
 #include <gtest/gtest.h>
 
+#include <cerrno>
 #include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "LibUsb.hpp"
+#include "UsbMetrics.hpp"
+
+static void
+usage(const char *p_program) {
+  std::cerr << "Usage: " << p_program << " [gtest options] [options]" << std::endl
+    << std::endl
+    << "Options:" << std::endl
+    << "  --usb-record=<file>                 Record all libusb Calls into <file>" << std::endl
+    << "  --usb-replay=<file>                 Serve all libusb Calls from <file> instead of a Device" << std::endl
+    << "  --usb-replay-timing=original|fast   Replay with recorded Timing (default) or as fast as possible" << std::endl
+    << "  --metrics-file=<file>               Periodically write Prometheus Metrics to <file>" << std::endl
+    << "  --metrics-interval=<ms>             Interval for --metrics-file (default: 1000)" << std::endl;
+}
 
 int
 main(int argc, char **argv) {
-  srand(time(NULL));
+  std::string recordFile, replayFile, metricsFile, error;
+  LibUsb::Timing timing = LibUsb::Timing::Original;
+  unsigned metricsInterval = 1000;
+  static const long maxMetricsInterval = 24 * 60 * 60 * 1000;
 
   ::testing::InitGoogleTest(&argc, argv);
-  return RUN_ALL_TESTS();
+
+  /* InitGoogleTest() removes all gtest Options, so only our own Options should be left */
+  for (int idx = 1; idx < argc; idx++) {
+    const std::string arg(argv[idx]);
+
+    if (arg.rfind("--usb-record=", 0) == 0) {
+      recordFile = arg.substr(arg.find('=') + 1);
+    } else if (arg.rfind("--usb-replay=", 0) == 0) {
+      replayFile = arg.substr(arg.find('=') + 1);
+    } else if (arg == "--usb-replay-timing=original") {
+      timing = LibUsb::Timing::Original;
+    } else if (arg == "--usb-replay-timing=fast") {
+      timing = LibUsb::Timing::Fast;
+    } else if (arg.rfind("--metrics-file=", 0) == 0) {
+      metricsFile = arg.substr(arg.find('=') + 1);
+    } else if (arg.rfind("--metrics-interval=", 0) == 0) {
+      const std::string value = arg.substr(arg.find('=') + 1);
+      char *end = nullptr;
+
+      errno = 0;
+      const long interval = strtol(value.c_str(), &end, 10);
+      if (value.empty() || (*end != '\0') || (errno != 0) || (interval < 1) || (interval > maxMetricsInterval)) {
+        std::cerr << "Invalid Metrics Interval '" << value << "', expected 1.." << maxMetricsInterval << "ms" << std::endl;
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      metricsInterval = interval;
+    } else {
+      std::cerr << "Unknown option '" << arg << "'" << std::endl;
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!recordFile.empty() && !replayFile.empty()) {
+    std::cerr << "--usb-record and --usb-replay are mutually exclusive" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  unsigned seed = time(NULL);
+
+  if (!replayFile.empty()) {
+    if (!LibUsb::replay(replayFile, timing, error)) {
+      std::cerr << error << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    /* Random Payloads must be the same as during the Recording */
+    seed = LibUsb::replaySeed();
+  } else if (!recordFile.empty()) {
+    if (!LibUsb::record(recordFile, seed, error)) {
+      std::cerr << error << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!metricsFile.empty()) {
+    if (!UsbMetrics::start(metricsFile, std::chrono::milliseconds(metricsInterval), error)) {
+      std::cerr << error << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  srand(seed);
+
+  int rc = RUN_ALL_TESTS();
+
+  UsbMetrics::stop();
+  if (!LibUsb::finish()) {
+    rc = EXIT_FAILURE;
+  }
+
+  return rc;
 }
@@ -10,7 +10,8 @@
 
 #include "UsbDeviceTest.hpp"
 
-class BulkTransferTest : public UsbDeviceTest {
+template<typename Transport>
+class BulkTransferTest : public UsbDeviceTest<Transport> {
 protected:
     void
     multipleBulkTransfers(const unsigned p_nTransfers, const unsigned p_nBytes) {
@@ -36,61 +37,63 @@ protected:
         /* Cast to non-const C-Style Pointer so our parameter can be a const Reference */
         uint8_t * const txBuf = const_cast<uint8_t * const>(p_txBuf.data());
 
-        rc = libusb_bulk_transfer(m_dutHandle, m_bulkOutEndpoint->bEndpointAddress, txBuf, p_txBuf.size(), &txLen, m_txTimeout);
+        rc = this->m_transport.bulkTransfer(this->m_dutHandle, this->m_bulkOutEndpoint->bEndpointAddress, txBuf, p_txBuf.size(), &txLen, this->m_txTimeout);
         EXPECT_EQ(LIBUSB_SUCCESS, rc) << "Bulk Tx transfer failed (Iteration #" << p_iteration << ")";
         EXPECT_EQ(txLen, p_txBuf.size());
 
-        rc = libusb_bulk_transfer(m_dutHandle, m_bulkInEndpoint->bEndpointAddress, rxBuf.data(), rxBuf.size(), &rxLen, m_rxTimeout);
+        rc = this->m_transport.bulkTransfer(this->m_dutHandle, this->m_bulkInEndpoint->bEndpointAddress, rxBuf.data(), rxBuf.size(), &rxLen, this->m_rxTimeout);
         EXPECT_EQ(LIBUSB_SUCCESS, rc) << "Bulk Rx transfer failed (Iteration #" << p_iteration << ")";
 
         EXPECT_EQ(p_txBuf, rxBuf) << "Iteration #" << p_iteration;
     }
 };
 
-TEST_F(BulkTransferTest, SingleTransferSmall) {
+TYPED_TEST_SUITE(BulkTransferTest, UsbTransports, UsbTransportNames);
+
+TYPED_TEST(BulkTransferTest, SingleTransferSmall) {
     const std::vector<uint8_t> txBuf { 0x12, 0x34, 0x56, 0x78 };
-    singleBulkTransfer(txBuf);
+    this->singleBulkTransfer(txBuf);
 }
 
-TEST_F(BulkTransferTest, SingleTransferSinglePacketMinusOne) {
-    singleBulkTransfer(m_bulkOutEndpoint->wMaxPacketSize - 1);
+TYPED_TEST(BulkTransferTest, SingleTransferSinglePacketMinusOne) {
+    this->singleBulkTransfer(this->m_bulkOutEndpoint->wMaxPacketSize - 1);
 }
 
-TEST_F(BulkTransferTest, SingleTransferSinglePacket) {
-    singleBulkTransfer(m_bulkOutEndpoint->wMaxPacketSize);
+TYPED_TEST(BulkTransferTest, SingleTransferSinglePacket) {
+    this->singleBulkTransfer(this->m_bulkOutEndpoint->wMaxPacketSize);
 }
 
-TEST_F(BulkTransferTest, SingleTransferSinglePacketPlusOne) {
-    singleBulkTransfer(m_bulkOutEndpoint->wMaxPacketSize + 1);
+TYPED_TEST(BulkTransferTest, SingleTransferSinglePacketPlusOne) {
+    this->singleBulkTransfer(this->m_bulkOutEndpoint->wMaxPacketSize + 1);
 }
 
-TEST_F(BulkTransferTest, SingleTransferTwoPackets) {
-    singleBulkTransfer(m_bulkOutEndpoint->wMaxPacketSize * 2);
+TYPED_TEST(BulkTransferTest, SingleTransferTwoPackets) {
+    this->singleBulkTransfer(this->m_bulkOutEndpoint->wMaxPacketSize * 2);
 }
 
-TEST_F(BulkTransferTest, DISABLED_SingleTransferMultiplePackets) {
-    singleBulkTransfer(m_bulkOutEndpoint->wMaxPacketSize * 3);
+TYPED_TEST(BulkTransferTest, DISABLED_SingleTransferMultiplePackets) {
+    this->singleBulkTransfer(this->m_bulkOutEndpoint->wMaxPacketSize * 3);
 }
 
-TEST_F(BulkTransferTest, SingleTransferBufferSizeMinusOne) {
-    singleBulkTransfer(m_maxBufferSz - 1);
+TYPED_TEST(BulkTransferTest, SingleTransferBufferSizeMinusOne) {
+    this->singleBulkTransfer(this->m_maxBufferSz - 1);
 }
 
-TEST_F(BulkTransferTest, SingleTransferBufferSize) {
-    singleBulkTransfer(m_maxBufferSz);
+TYPED_TEST(BulkTransferTest, SingleTransferBufferSize) {
+    this->singleBulkTransfer(this->m_maxBufferSz);
 }
 
-TEST_F(BulkTransferTest, DISABLED_SingleTransferBufferSizePlusOne) {
-    singleBulkTransfer(m_maxBufferSz + 1);
+TYPED_TEST(BulkTransferTest, DISABLED_SingleTransferBufferSizePlusOne) {
+    this->singleBulkTransfer(this->m_maxBufferSz + 1);
 }
 
-TEST_F(BulkTransferTest, MultiTransferSmall) {
+TYPED_TEST(BulkTransferTest, MultiTransferSmall) {
     const std::vector<uint8_t> txBuf1 { 0x12, 0x34, 0x56, 0x78 };
     const std::vector<uint8_t> txBuf2 { 0x90, 0xab, 0xcd, 0xef, 0x12, 0x34 };
 
-    singleBulkTransfer(txBuf1, 0);
+    this->singleBulkTransfer(txBuf1, 0);
     // sleep(1);
-    singleBulkTransfer(txBuf2, 1);
+    this->singleBulkTransfer(txBuf2, 1);
 }
 
 #if 0
@@ -115,10 +118,10 @@ TEST_F(BulkTransferTest, DISABLED_LoopbackMultiple) {
         rxBuf.resize(txBuf.size());
         ASSERT_EQ(rxBuf.size(), txBuf.size());
 
-        rc = libusb_bulk_transfer(m_dutHandle, m_outEndpoint, const_cast<unsigned char *>(txBuf.data()), txBuf.size(), &txLen, m_txTimeout);
+        rc = LibUsb::bulkTransfer(m_dutHandle, m_outEndpoint, const_cast<unsigned char *>(txBuf.data()), txBuf.size(), &txLen, m_txTimeout);
         EXPECT_EQ(LIBUSB_SUCCESS, rc) << "Bulk Tx transfer failed in repetition #" << cnt;
 
-        rc = libusb_bulk_transfer(m_dutHandle, m_inEndpoint, rxBuf.data(), std::min(static_cast<size_t>(txLen), rxBuf.size()), &rxLen, m_rxTimeout);
+        rc = LibUsb::bulkTransfer(m_dutHandle, m_inEndpoint, rxBuf.data(), std::min(static_cast<size_t>(txLen), rxBuf.size()), &rxLen, m_rxTimeout);
         EXPECT_EQ(LIBUSB_SUCCESS, rc) << "Bulk Rx transfer failed in repetition #" << cnt;
 
         EXPECT_EQ(txBuf, rxBuf);
@@ -0,0 +1,265 @@
+/*-
+ * $Copyright$
+ */
+
+#include <libusb-1.0/libusb.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <climits>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include "LatencyStatistics.hpp"
+#include "UsbDeviceTest.hpp"
+
+/*
+ * Benchmark for the Configuration and Interface Life-cycle of the USB Device.
+ *
+ * Each cycle activates the Test Configuration, claims the Loopback Interface,
+ * runs a single Loopback Transfer, releases the Interface and returns the
+ * Device to the "unconfigured" state. The latency of each step is recorded
+ * separately so slow SET_CONFIGURATION handling in the Firmware stands out.
+ *
+ * Leaks are detected by checking the Device's state after every cycle, by
+ * comparing the Loopback latency at the start and at the end of the run, and
+ * (on Linux) by comparing the number of usbfs File Descriptors of the process.
+ */
+template<typename Transport>
+class ConfigurationChurnTest : public UsbDeviceTest<Transport> {
+protected:
+    static constexpr unsigned   m_warmupCycles      = 10;
+    static constexpr unsigned   m_cycles            = 2000;
+    static constexpr unsigned   m_maxLatencyDrift   = 4;    // Max. Ratio of late vs. early median Loopback Latency
+
+    unsigned                m_timeout;
+
+    LatencyStatistics       m_setConfiguration;
+    LatencyStatistics       m_getDescriptor;
+    LatencyStatistics       m_claimInterface;
+    LatencyStatistics       m_firstLoopback;
+    LatencyStatistics       m_releaseInterface;
+    LatencyStatistics       m_resetConfiguration;
+    LatencyStatistics       m_cycle;
+
+    ConfigurationChurnTest()
+      : m_timeout(UsbDeviceTest<Transport>::m_maxBulkTimeout),
+        m_setConfiguration("set_configuration"),
+        m_getDescriptor("get_config_descriptor"),
+        m_claimInterface("claim_interface"),
+        m_firstLoopback("first_loopback"),
+        m_releaseInterface("release_interface"),
+        m_resetConfiguration("reset_configuration"),
+        m_cycle("cycle")
+    {
+
+    }
+
+    /*
+     * Only opens the Device; the Cycles configure and claim it. The Fixture's
+     * State (m_activeConfiguration, m_configDescriptor, m_interfaceClaimed) is
+     * kept up to date by each Cycle, so libUsbCleanUp() can clean up after a
+     * failed Cycle.
+     */
+    void libUsbInit(void) override {
+        ASSERT_NO_FATAL_FAILURE(this->initContext());
+        ASSERT_NO_FATAL_FAILURE(this->getDeviceList());
+        ASSERT_NO_FATAL_FAILURE(this->findDevice());
+        ASSERT_NO_FATAL_FAILURE(this->openDevice());
+
+        int cfgNum;
+        int rc = this->m_transport.getConfiguration(this->m_dutHandle, &cfgNum);
+        EXPECT_EQ(0, rc);
+        ASSERT_EQ(0, cfgNum) << "Expected USB Device to be unconfigured but Configuration '" << cfgNum << "' is already active.";
+
+        m_timeout = DeviceWatchdog::timeout(UsbMetrics::Transfer::Bulk, this->m_maxBulkTimeout);
+    }
+
+    /*
+     * Only File Descriptors of USB Devices (usbfs) are counted. Other Threads,
+     * e.g. the Metrics Exporter, open and close Files at any time.
+     */
+    static int
+    countUsbFileDescriptors(void) {
+#if defined(__linux__)
+        static const std::string usbfs = "/dev/bus/usb/";
+
+        DIR *dir = opendir("/proc/self/fd");
+        if (dir == nullptr) {
+            return -1;
+        }
+
+        int cnt = 0;
+        for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+            char target[PATH_MAX];
+
+            const std::string link = std::string("/proc/self/fd/") + entry->d_name;
+            const ssize_t len = readlink(link.c_str(), target, sizeof(target) - 1);
+            if (len <= 0) {
+                continue;
+            }
+            target[len] = '\0';
+
+            if (std::string(target).rfind(usbfs, 0) == 0) {
+                cnt++;
+            }
+        }
+        closedir(dir);
+
+        return cnt;
+#else
+        return -1;
+#endif
+    }
+
+    void
+    singleCycle(const unsigned p_cycle) {
+        LatencyStatistics::Clock::time_point start, end, cycleStart;
+        int rc, cfgNum;
+
+        cycleStart = LatencyStatistics::Clock::now();
+
+        /* Activate the Test Configuration */
+        start = LatencyStatistics::Clock::now();
+        rc = this->m_transport.setConfiguration(this->m_dutHandle, this->m_testConfiguration);
+        end = LatencyStatistics::Clock::now();
+        ASSERT_EQ(LIBUSB_SUCCESS, rc) << "Configuration '" << this->m_testConfiguration << "' could not be activated (Cycle #" << p_cycle << ")";
+        this->m_activeConfiguration = this->m_testConfiguration;
+        m_setConfiguration.add(start, end);
+
+        /* Fetch the active Configuration's Descriptor */
+        start = LatencyStatistics::Clock::now();
+        rc = this->m_transport.getActiveConfigDescriptor(this->m_dutRef, const_cast<libusb_config_descriptor **>(&this->m_configDescriptor));
+        end = LatencyStatistics::Clock::now();
+        ASSERT_EQ(0, rc) << "Failed to read Configuration Descriptor (Cycle #" << p_cycle << ")";
+        m_getDescriptor.add(start, end);
+
+        ASSERT_NO_FATAL_FAILURE(this->findLoopbackInterface()) << "Cycle #" << p_cycle;
+        ASSERT_NO_FATAL_FAILURE(this->findBulkEndpoints()) << "Cycle #" << p_cycle;
+
+        /* Claim the Loopback Interface */
+        const int interface = this->m_interfaceDescriptor->bInterfaceNumber;
+
+        start = LatencyStatistics::Clock::now();
+        rc = this->m_transport.claimInterface(this->m_dutHandle, interface);
+        end = LatencyStatistics::Clock::now();
+        ASSERT_EQ(0, rc) << "Failed to claim Interface " << interface << " (Cycle #" << p_cycle << ")";
+        this->m_interfaceClaimed = true;
+        m_claimInterface.add(start, end);
+
+        /*
+         * First Loopback Transfer after claiming the Interface. The Payload carries the
+         * Cycle Number so stale data left over in the Device from a previous cycle is
+         * detected.
+         */
+        std::vector<uint8_t> txBuf {
+            0xC5,
+            static_cast<uint8_t>(p_cycle >> 16),
+            static_cast<uint8_t>(p_cycle >> 8),
+            static_cast<uint8_t>(p_cycle >> 0)
+        };
+        std::vector<uint8_t> rxBuf(txBuf.size());
+        int txLen, rxLen;
+
+        start = LatencyStatistics::Clock::now();
+        rc = this->m_transport.bulkTransfer(this->m_dutHandle, this->m_bulkOutEndpoint->bEndpointAddress, txBuf.data(), txBuf.size(), &txLen, m_timeout);
+        ASSERT_EQ(LIBUSB_SUCCESS, rc) << "Bulk Tx transfer failed (Cycle #" << p_cycle << ")";
+        rc = this->m_transport.bulkTransfer(this->m_dutHandle, this->m_bulkInEndpoint->bEndpointAddress, rxBuf.data(), rxBuf.size(), &rxLen, m_timeout);
+        end = LatencyStatistics::Clock::now();
+        ASSERT_EQ(LIBUSB_SUCCESS, rc) << "Bulk Rx transfer failed (Cycle #" << p_cycle << ")";
+        ASSERT_EQ(txBuf, rxBuf) << "Cycle #" << p_cycle;
+        m_firstLoopback.add(start, end);
+
+        /* Release the Loopback Interface */
+        start = LatencyStatistics::Clock::now();
+        rc = this->m_transport.releaseInterface(this->m_dutHandle, interface);
+        end = LatencyStatistics::Clock::now();
+        this->m_interfaceClaimed = false;
+        ASSERT_EQ(0, rc) << "Failed to release Interface (Cycle #" << p_cycle << ")";
+        m_releaseInterface.add(start, end);
+
+        /* The Interface and Endpoint Descriptors point into the Configuration Descriptor */
+        this->m_transport.freeConfigDescriptor(const_cast<libusb_config_descriptor *>(this->m_configDescriptor));
+        this->m_configDescriptor = nullptr;
+        this->m_interfaceDescriptor = nullptr;
+        this->m_bulkOutEndpoint = nullptr;
+        this->m_bulkInEndpoint = nullptr;
+
+        /* Reset the Device to the "unconfigured" state */
+        start = LatencyStatistics::Clock::now();
+        rc = this->m_transport.setConfiguration(this->m_dutHandle, -1);
+        end = LatencyStatistics::Clock::now();
+        ASSERT_EQ(LIBUSB_SUCCESS, rc) << "Configuration could not be de-activated (Cycle #" << p_cycle << ")";
+        this->m_activeConfiguration = 0;
+        m_resetConfiguration.add(start, end);
+
+        rc = this->m_transport.getConfiguration(this->m_dutHandle, &cfgNum);
+        EXPECT_EQ(0, rc);
+        ASSERT_EQ(0, cfgNum) << "Expected USB Device Configuration '0', but Configuration '" << cfgNum << "' is active (Cycle #" << p_cycle << ")";
+
+        m_cycle.add(cycleStart, LatencyStatistics::Clock::now());
+    }
+
+    void
+    report(void) const {
+        for (const LatencyStatistics *stats : {
+          &m_setConfiguration, &m_getDescriptor, &m_claimInterface, &m_firstLoopback,
+          &m_releaseInterface, &m_resetConfiguration, &m_cycle })
+        {
+            std::cout << "[ ChurnStat] " << *stats << std::endl;
+            stats->recordProperties();
+        }
+    }
+};
+
+TYPED_TEST_SUITE(ConfigurationChurnTest, UsbTransports, UsbTransportNames);
+
+TYPED_TEST(ConfigurationChurnTest, ConfigureClaimLoopbackReleaseCycles) {
+    /*
+     * Warm-up cycles are not measured; libusb may lazily open File Descriptors or
+     * allocate Resources when the Device is configured for the first time.
+     */
+    for (unsigned cycle = 0; cycle < this->m_warmupCycles; cycle++) {
+        this->singleCycle(cycle);
+        ASSERT_FALSE(this->HasFatalFailure()) << "Warm-up Cycle #" << cycle << " failed.";
+    }
+
+    for (LatencyStatistics *stats : {
+      &this->m_setConfiguration, &this->m_getDescriptor, &this->m_claimInterface, &this->m_firstLoopback,
+      &this->m_releaseInterface, &this->m_resetConfiguration, &this->m_cycle })
+    {
+        stats->clear();
+    }
+
+    const int fdsBefore = TestFixture::countUsbFileDescriptors();
+
+    for (unsigned cycle = this->m_warmupCycles; cycle < this->m_warmupCycles + this->m_cycles; cycle++) {
+        this->singleCycle(cycle);
+        if (this->HasFatalFailure()) {
+            this->report();
+            FAIL() << "Cycle #" << cycle << " failed after " << (cycle - this->m_warmupCycles) << " measured cycles.";
+        }
+    }
+
+    const int fdsAfter = TestFixture::countUsbFileDescriptors();
+
+    this->report();
+
+    EXPECT_EQ(fdsBefore, fdsAfter) << "Number of open usbfs File Descriptors changed across " << this->m_cycles << " cycles.";
+
+    /* Growing Loopback Latency hints at Resources leaking in the Firmware */
+    const size_t window = this->m_firstLoopback.count() / 10;
+    const LatencyStatistics::Duration early = this->m_firstLoopback.quantile(0.5, 0, window);
+    const LatencyStatistics::Duration late = this->m_firstLoopback.quantile(0.5, this->m_firstLoopback.count() - window, this->m_firstLoopback.count());
+
+    EXPECT_LE(late.count(), early.count() * this->m_maxLatencyDrift)
+      << "Median Loopback Latency grew from " << early.count() << "ns in the first "
+      << window << " cycles to " << late.count() << "ns in the last " << window << " cycles.";
+}
@@ -0,0 +1,312 @@
+/*-
+ * $Copyright$
+ */
+
+#include <libusb-1.0/libusb.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LatencyStatistics.hpp"
+#include "LibUsb.hpp"
+#include "UsbDeviceTest.hpp"
+
+/*
+ * Benchmark for Transfers issued from several Threads to one shared Device Handle.
+ *
+ * Each Thread issues a fixed number of Operations: every m_controlEvery-th one
+ * is a Control Transfer (GET_STATUS), all others are a Bulk OUT -> IN Loopback
+ * Pair. The Device has a single Loopback FIFO, so the Harness serializes the
+ * Loopback Pairs with its own Lock; the Time spent waiting for it is reported as
+ * "harness_lock_wait". This is not a Measurement of Locking inside libusb. Control
+ * Transfers are issued without the Lock, so they contend in libusb and in the
+ * Firmware with the Bulk Transfers of the other Threads.
+ *
+ * Each Loopback Payload is tagged with the Thread Index and a Sequence Number,
+ * so a Thread receiving another Thread's Data is detected.
+ *
+ * Throughput and Latencies are reported per Thread Count to show how they
+ * scale.
+ */
+template<typename Transport>
+class ContentionTest : public UsbDeviceTest<Transport> {
+protected:
+    static constexpr unsigned   m_maxThreads        = 8;
+    static constexpr unsigned   m_opsPerThread      = 200;
+    static constexpr unsigned   m_controlEvery      = 4;
+    static constexpr unsigned   m_payloadSz         = 32;
+    static constexpr unsigned   m_maxControlTimeout = 1500;
+
+    struct ThreadResult {
+        LatencyStatistics   m_control;
+        LatencyStatistics   m_loopback;
+        LatencyStatistics   m_harnessLockWait;
+        uint64_t            m_bytes;
+        unsigned            m_outErrors;
+        unsigned            m_inErrors;
+        unsigned            m_errors;
+        unsigned            m_mismatches;
+        unsigned            m_foreignData;
+
+        ThreadResult(void)
+          : m_control("control"), m_loopback("loopback"), m_harnessLockWait("harness_lock_wait"),
+            m_bytes(0), m_outErrors(0), m_inErrors(0), m_errors(0), m_mismatches(0), m_foreignData(0) {
+
+        }
+    };
+
+    struct Summary {
+        unsigned    m_threads;
+        double      m_throughput;       /* Bytes per Second */
+        double      m_transferRate;     /* Transfers per Second */
+        LatencyStatistics::Duration m_worstLoopbackP99;
+        LatencyStatistics::Duration m_worstControlP99;
+        LatencyStatistics::Duration m_harnessLockWaitP99;
+    };
+
+    std::mutex              m_loopbackLock;
+    std::atomic<bool>       m_go;
+    unsigned                m_controlTimeout;
+
+    static void
+    fillPayload(std::vector<uint8_t> &p_payload, uint32_t p_thread, uint32_t p_sequence) {
+        for (unsigned idx = 0; idx < sizeof(uint32_t); idx++) {
+            p_payload[idx] = static_cast<uint8_t>(p_thread >> (8 * idx));
+            p_payload[sizeof(uint32_t) + idx] = static_cast<uint8_t>(p_sequence >> (8 * idx));
+        }
+
+        for (unsigned idx = 2 * sizeof(uint32_t); idx < p_payload.size(); idx++) {
+            p_payload[idx] = static_cast<uint8_t>((p_thread * 31) + (p_sequence * 7) + idx);
+        }
+    }
+
+    static uint32_t
+    payloadThread(const std::vector<uint8_t> &p_payload) {
+        uint32_t thread = 0;
+
+        for (unsigned idx = 0; idx < sizeof(uint32_t); idx++) {
+            thread |= static_cast<uint32_t>(p_payload[idx]) << (8 * idx);
+        }
+
+        return thread;
+    }
+
+    void
+    controlTransfer(ThreadResult &p_result) {
+        uint8_t status[sizeof(uint16_t)];
+
+        const LatencyStatistics::Clock::time_point start = LatencyStatistics::Clock::now();
+        int rc = this->m_transport.controlTransfer(this->m_dutHandle,
+            (1 << 7)    /* Direction: Device to Host */
+          | (0 << 5)    /* Type: Standard */
+          | (0 << 0),   /* Recipient: Device */
+          0x0,          /* bRequest = Get Status */
+          0x0,          /* wValue */
+          0x0,          /* wIndex */
+          status,
+          sizeof(status),
+          m_controlTimeout
+        );
+        p_result.m_control.add(start, LatencyStatistics::Clock::now());
+
+        if (rc != sizeof(status)) {
+            p_result.m_errors++;
+        }
+    }
+
+    void
+    loopbackTransfer(ThreadResult &p_result, unsigned p_thread, unsigned p_sequence,
+      std::vector<uint8_t> &p_txBuf, std::vector<uint8_t> &p_rxBuf)
+    {
+        int rc, txLen = 0, rxLen = 0;
+
+        fillPayload(p_txBuf, p_thread, p_sequence);
+        std::fill(p_rxBuf.begin(), p_rxBuf.end(), 0);
+
+        const LatencyStatistics::Clock::time_point wait = LatencyStatistics::Clock::now();
+        std::lock_guard<std::mutex> lock(m_loopbackLock);
+
+        const LatencyStatistics::Clock::time_point start = LatencyStatistics::Clock::now();
+        p_result.m_harnessLockWait.add(wait, start);
+
+        rc = this->m_transport.bulkTransfer(this->m_dutHandle, this->m_bulkOutEndpoint->bEndpointAddress,
+          p_txBuf.data(), p_txBuf.size(), &txLen, this->m_txTimeout);
+        if ((rc != LIBUSB_SUCCESS) || (txLen != static_cast<int>(p_txBuf.size()))) {
+            p_result.m_outErrors++;
+
+            /* Drain what reached the Device, so the next Pair does not receive it as foreign Data */
+            if (txLen > 0) {
+                this->m_transport.bulkTransfer(this->m_dutHandle, this->m_bulkInEndpoint->bEndpointAddress,
+                  p_rxBuf.data(), p_rxBuf.size(), &rxLen, this->m_rxTimeout);
+            }
+            return;
+        }
+
+        rc = this->m_transport.bulkTransfer(this->m_dutHandle, this->m_bulkInEndpoint->bEndpointAddress,
+          p_rxBuf.data(), p_rxBuf.size(), &rxLen, this->m_rxTimeout);
+        p_result.m_loopback.add(start, LatencyStatistics::Clock::now());
+
+        if ((rc != LIBUSB_SUCCESS) || (rxLen < txLen)) {
+            p_result.m_inErrors++;
+
+            /* Drain the Rest of the Payload, so the next Pair does not receive it as foreign Data */
+            this->m_transport.bulkTransfer(this->m_dutHandle, this->m_bulkInEndpoint->bEndpointAddress,
+              p_rxBuf.data(), p_rxBuf.size(), &rxLen, this->m_rxTimeout);
+        } else if (payloadThread(p_rxBuf) != p_thread) {
+            p_result.m_foreignData++;
+        } else if ((rxLen != txLen) || (p_rxBuf != p_txBuf)) {
+            p_result.m_mismatches++;
+        } else {
+            p_result.m_bytes += txLen + rxLen;
+        }
+    }
+
+    void
+    worker(unsigned p_thread, ThreadResult &p_result) {
+        std::vector<uint8_t> txBuf(m_payloadSz), rxBuf(m_payloadSz);
+
+        while (!m_go.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+
+        for (unsigned op = 0; op < m_opsPerThread; op++) {
+            if ((op % m_controlEvery) == (m_controlEvery - 1)) {
+                controlTransfer(p_result);
+            } else {
+                loopbackTransfer(p_result, p_thread, op, txBuf, rxBuf);
+            }
+        }
+    }
+
+    Summary
+    run(unsigned p_threads) {
+        std::vector<ThreadResult> results(p_threads);
+        std::vector<std::thread> threads;
+
+        m_go.store(false);
+        for (unsigned idx = 0; idx < p_threads; idx++) {
+            threads.emplace_back(&ContentionTest::worker, this, idx, std::ref(results[idx]));
+        }
+
+        const LatencyStatistics::Clock::time_point start = LatencyStatistics::Clock::now();
+        m_go.store(true, std::memory_order_release);
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        const double elapsed = std::chrono::duration<double>(LatencyStatistics::Clock::now() - start).count();
+
+        const std::string prefix = "threads_" + std::to_string(p_threads);
+        LatencyStatistics control(prefix + ".control"), loopback(prefix + ".loopback"), harnessLockWait(prefix + ".harness_lock_wait");
+        Summary summary { p_threads, 0, 0, LatencyStatistics::Duration::zero(), LatencyStatistics::Duration::zero(), LatencyStatistics::Duration::zero() };
+        uint64_t bytes = 0;
+
+        for (unsigned idx = 0; idx < p_threads; idx++) {
+            const ThreadResult &result = results[idx];
+
+            EXPECT_EQ(0u, result.m_outErrors) << "Thread #" << idx << " of " << p_threads << ": failed Bulk OUT Transfers";
+            EXPECT_EQ(0u, result.m_inErrors) << "Thread #" << idx << " of " << p_threads << ": failed or short Bulk IN Transfers";
+            EXPECT_EQ(0u, result.m_errors) << "Thread #" << idx << " of " << p_threads << ": failed Control Transfers";
+            EXPECT_EQ(0u, result.m_foreignData) << "Thread #" << idx << " of " << p_threads << ": received another Thread's Loopback Data";
+            EXPECT_EQ(0u, result.m_mismatches) << "Thread #" << idx << " of " << p_threads << ": corrupted Loopback Data";
+
+            control.add(result.m_control);
+            loopback.add(result.m_loopback);
+            harnessLockWait.add(result.m_harnessLockWait);
+            bytes += result.m_bytes;
+
+            if (result.m_loopback.count() > 0) {
+                summary.m_worstLoopbackP99 = std::max(summary.m_worstLoopbackP99, result.m_loopback.quantile(0.99));
+            }
+            if (result.m_control.count() > 0) {
+                summary.m_worstControlP99 = std::max(summary.m_worstControlP99, result.m_control.quantile(0.99));
+            }
+        }
+
+        summary.m_throughput = (elapsed > 0) ? (bytes / elapsed) : 0.0;
+        summary.m_transferRate = (elapsed > 0) ? ((control.count() + 2 * loopback.count()) / elapsed) : 0.0;
+        if (harnessLockWait.count() > 0) {
+            summary.m_harnessLockWaitP99 = harnessLockWait.quantile(0.99);
+        }
+
+        for (const LatencyStatistics *stats : { &control, &loopback, &harnessLockWait }) {
+            if (stats->count() > 0) {
+                stats->recordProperties();
+                std::cout << "[ Contention] " << *stats << std::endl;
+            }
+        }
+
+        std::ostringstream throughput;
+        throughput << std::fixed << std::setprecision(1) << (summary.m_throughput / 1024.0);
+        this->RecordProperty(prefix + ".throughput_kib_s", throughput.str());
+        this->RecordProperty(prefix + ".transfers_per_s", std::to_string(static_cast<uint64_t>(summary.m_transferRate)));
+        this->RecordProperty(prefix + ".loopback.worst_thread_p99_us", LatencyStatistics::formatMicroseconds(summary.m_worstLoopbackP99));
+        this->RecordProperty(prefix + ".control.worst_thread_p99_us", LatencyStatistics::formatMicroseconds(summary.m_worstControlP99));
+
+        return summary;
+    }
+
+    static void
+    report(std::ostream &p_os, const std::vector<Summary> &p_summaries) {
+        std::ostringstream os;
+
+        os << "[ Contention] Scaling with the Number of Threads:" << std::endl;
+        for (const Summary &summary : p_summaries) {
+            const double baseline = p_summaries.front().m_throughput;
+
+            os << "[ Contention]   threads=" << std::setw(2) << summary.m_threads
+              << std::fixed << std::setprecision(1)
+              << " throughput=" << (summary.m_throughput / 1024.0) << "KiB/s"
+              << " (x" << std::setprecision(2) << ((baseline > 0) ? (summary.m_throughput / baseline) : 0.0) << ")"
+              << std::setprecision(0) << " transfers/s=" << summary.m_transferRate
+              << " worst-thread p99 loopback=" << LatencyStatistics::formatMicroseconds(summary.m_worstLoopbackP99) << "us"
+              << " control=" << LatencyStatistics::formatMicroseconds(summary.m_worstControlP99) << "us"
+              << " harness-lock-wait p99=" << LatencyStatistics::formatMicroseconds(summary.m_harnessLockWaitP99) << "us"
+              << std::endl;
+        }
+
+        p_os << os.str();
+    }
+
+    void SetUp(void) override {
+        /*
+         * The Interleaving of the Threads' Calls differs from Run to Run, so a
+         * Capture File would not replay. Skip before libusb is touched so the
+         * Capture stays consistent. Transports that do not use the Device never
+         * touch the Capture and still run.
+         */
+        if (Transport::usesDevice() && (LibUsb::mode() != LibUsb::Mode::Passthrough)) {
+            GTEST_SKIP() << "Multi-threaded Transfers cannot be recorded or replayed.";
+        }
+
+        UsbDeviceTest<Transport>::SetUp();
+    }
+};
+
+TYPED_TEST_SUITE(ContentionTest, UsbTransports, UsbTransportNames);
+
+TYPED_TEST(ContentionTest, SharedHandleScaling) {
+    std::vector<typename TestFixture::Summary> summaries;
+
+    for (unsigned threads = 1; threads <= TestFixture::m_maxThreads; threads *= 2) {
+        this->m_controlTimeout = DeviceWatchdog::timeout(UsbMetrics::Transfer::Control, TestFixture::m_maxControlTimeout);
+        this->m_txTimeout = DeviceWatchdog::timeout(UsbMetrics::Transfer::Bulk, TestFixture::m_maxBulkTimeout);
+        this->m_rxTimeout = DeviceWatchdog::timeout(UsbMetrics::Transfer::Bulk, TestFixture::m_maxBulkTimeout);
+
+        summaries.push_back(this->run(threads));
+        if (this->HasFailure()) {
+            break;
+        }
+    }
+
+    TestFixture::report(std::cout, summaries);
+}
@@ -0,0 +1,278 @@
+/*-
+ * $Copyright$
+ */
+
+#include <libusb-1.0/libusb.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+#include "LatencyStatistics.hpp"
+#include "UsbDeviceTest.hpp"
+
+/*
+ * Loopback Performance Matrix over Data Pattern x Host Buffer Alignment x Transfer Length.
+ *
+ * Each cell of the matrix runs a number of Loopback Transfers and reports the
+ * Throughput and the Latency distribution, both on stdout and in the gtest
+ * XML/JSON Output. At the end of the Test Suite, the cells that are slowest
+ * compared to other cells with the same Transfer Length are listed.
+ */
+enum class DataPattern {
+    Zeros,
+    Ones,
+    Incrementing,
+    Prbs,
+    Random
+};
+
+/*
+ * Transfer Lengths, relative to the Bulk Endpoint's wMaxPacketSize. The "Mod4"
+ * and "Mod8" Lengths are placed around half a Packet (at least 8 Bytes) so
+ * that they differ only in their Residue modulo 4 and 8, respectively. With
+ * small Packets, some Lengths coincide with the Packet-relative ones; Results
+ * are still grouped by TransferLength.
+ */
+enum class TransferLength {
+    Mod4Residue0,
+    Mod4Residue1,
+    Mod4Residue2,
+    Mod4Residue3,
+    Mod8Residue4,
+    PacketMinusOne,
+    Packet,
+    PacketPlusOne,
+    TwoPackets
+};
+
+static const char *
+name(DataPattern p_pattern) {
+    switch (p_pattern) {
+    case DataPattern::Zeros:          return "Zeros";
+    case DataPattern::Ones:           return "Ones";
+    case DataPattern::Incrementing:   return "Incrementing";
+    case DataPattern::Prbs:           return "Prbs";
+    case DataPattern::Random:         return "Random";
+    }
+    return "Unknown";
+}
+
+static const char *
+name(TransferLength p_length) {
+    switch (p_length) {
+    case TransferLength::Mod4Residue0:    return "Mod4Residue0";
+    case TransferLength::Mod4Residue1:    return "Mod4Residue1";
+    case TransferLength::Mod4Residue2:    return "Mod4Residue2";
+    case TransferLength::Mod4Residue3:    return "Mod4Residue3";
+    case TransferLength::Mod8Residue4:    return "Mod8Residue4";
+    case TransferLength::PacketMinusOne:  return "PacketMinusOne";
+    case TransferLength::Packet:          return "Packet";
+    case TransferLength::PacketPlusOne:   return "PacketPlusOne";
+    case TransferLength::TwoPackets:      return "TwoPackets";
+    }
+    return "Unknown";
+}
+
+static unsigned
+length(TransferLength p_length, unsigned p_maxPacketSize) {
+    /* With 8 Byte Packets (Full Speed), half a Packet rounds down to 0; start at 8 Bytes instead */
+    const unsigned half = std::max((p_maxPacketSize / 2) & ~7u, 8u);
+
+    switch (p_length) {
+    case TransferLength::Mod4Residue0:    return half + 0;
+    case TransferLength::Mod4Residue1:    return half + 1;
+    case TransferLength::Mod4Residue2:    return half + 2;
+    case TransferLength::Mod4Residue3:    return half + 3;
+    case TransferLength::Mod8Residue4:    return half + 4;
+    case TransferLength::PacketMinusOne:  return p_maxPacketSize - 1;
+    case TransferLength::Packet:          return p_maxPacketSize;
+    case TransferLength::PacketPlusOne:   return p_maxPacketSize + 1;
+    case TransferLength::TwoPackets:      return p_maxPacketSize * 2;
+    }
+    return 0;
+}
+
+/* Host Buffer Offsets, relative to a Cache-Line aligned Address */
+static const unsigned bufferOffsets[] = { 0, 1, 2, 3, 4, 8 };
+static const unsigned bufferAlignment = 64;
+
+typedef std::tuple<DataPattern, unsigned, TransferLength> DataPatternParam;
+
+class DataPatternTest : public UsbDeviceTest<SyncLibUsbTransport>, public ::testing::WithParamInterface<DataPatternParam> {
+protected:
+    static const unsigned   m_iterations;
+
+    struct Result {
+        std::string         m_cell;
+        unsigned            m_length;       /* Bytes */
+        double              m_throughput;   /* Bytes per Second */
+    };
+
+    static std::map<TransferLength, std::vector<Result>>    m_results;
+
+    /* PRBS-31 (x^31 + x^28 + 1) State, carried across Iterations */
+    uint32_t                m_prbsState;
+
+    DataPatternTest(void) : m_prbsState(0x7FFFFFFF) {
+
+    }
+
+    uint8_t
+    nextPrbsByte(void) {
+        uint8_t byte = 0;
+
+        for (unsigned bit = 0; bit < 8; bit++) {
+            const uint32_t feedback = ((m_prbsState >> 30) ^ (m_prbsState >> 27)) & 1;
+            m_prbsState = ((m_prbsState << 1) | feedback) & 0x7FFFFFFF;
+            byte = (byte << 1) | feedback;
+        }
+
+        return byte;
+    }
+
+    void
+    fill(DataPattern p_pattern, uint8_t *p_buffer, unsigned p_length, unsigned p_iteration) {
+        switch (p_pattern) {
+        case DataPattern::Zeros:
+            std::fill_n(p_buffer, p_length, 0x00);
+            break;
+        case DataPattern::Ones:
+            std::fill_n(p_buffer, p_length, 0xFF);
+            break;
+        case DataPattern::Incrementing:
+            for (unsigned idx = 0; idx < p_length; idx++) {
+                p_buffer[idx] = static_cast<uint8_t>(p_iteration + idx);
+            }
+            break;
+        case DataPattern::Prbs:
+            std::generate_n(p_buffer, p_length, [&]{ return nextPrbsByte(); });
+            break;
+        case DataPattern::Random:
+            std::generate_n(p_buffer, p_length, [&]{ return rand(); });
+            break;
+        }
+    }
+
+    /* Returns a Pointer into p_storage that is p_offset Bytes past a Cache-Line aligned Address */
+    static uint8_t *
+    alignedBuffer(std::vector<uint8_t> &p_storage, unsigned p_length, unsigned p_offset) {
+        p_storage.resize(p_length + bufferAlignment + p_offset);
+
+        const uintptr_t address = reinterpret_cast<uintptr_t>(p_storage.data());
+        const uintptr_t aligned = (address + bufferAlignment - 1) & ~static_cast<uintptr_t>(bufferAlignment - 1);
+
+        return p_storage.data() + (aligned - address) + p_offset;
+    }
+
+public:
+    static void
+    TearDownTestSuite(void) {
+        UsbDeviceTest<SyncLibUsbTransport>::TearDownTestSuite();
+
+        std::cout << "[ Patterns ] Slowest cells compared to the median Throughput of their Transfer Length:" << std::endl;
+
+        for (auto &lengthResults : m_results) {
+            std::vector<Result> &results = lengthResults.second;
+            if (results.empty()) {
+                continue;
+            }
+
+            std::sort(results.begin(), results.end(), [](const Result &a, const Result &b) {
+                return a.m_throughput < b.m_throughput;
+            });
+            const double median = results[results.size() / 2].m_throughput;
+
+            for (unsigned idx = 0; (idx < 3) && (idx < results.size()); idx++) {
+                std::cout << "[ Patterns ]   len=" << std::setw(4) << results[idx].m_length
+                  << " " << std::setw(40) << std::left << results[idx].m_cell << std::right
+                  << std::fixed << std::setprecision(2)
+                  << (results[idx].m_throughput / 1024.0) << " KiB/s ("
+                  << ((median > 0) ? (100.0 * results[idx].m_throughput / median) : 0.0) << "% of median)"
+                  << std::endl;
+            }
+        }
+
+        m_results.clear();
+    }
+};
+
+const unsigned DataPatternTest::m_iterations = 100;
+std::map<TransferLength, std::vector<DataPatternTest::Result>> DataPatternTest::m_results;
+
+TEST_P(DataPatternTest, Loopback) {
+    const DataPattern pattern = std::get<0>(GetParam());
+    const unsigned offset = std::get<1>(GetParam());
+    const unsigned len = length(std::get<2>(GetParam()), m_bulkOutEndpoint->wMaxPacketSize);
+
+    if (len > m_maxBufferSz) {
+        GTEST_SKIP() << "Transfer Length " << len << " exceeds the Device's Buffer of " << m_maxBufferSz << " Bytes";
+    }
+
+    std::vector<uint8_t> txStorage, rxStorage;
+    uint8_t * const txBuf = alignedBuffer(txStorage, len, offset);
+    uint8_t * const rxBuf = alignedBuffer(rxStorage, len, offset);
+
+    LatencyStatistics latency("loopback");
+    int rc, txLen, rxLen;
+
+    for (unsigned iteration = 0; iteration < m_iterations; iteration++) {
+        fill(pattern, txBuf, len, iteration);
+        std::fill_n(rxBuf, len, ~txBuf[0]);
+
+        const LatencyStatistics::Clock::time_point start = LatencyStatistics::Clock::now();
+
+        rc = m_transport.bulkTransfer(m_dutHandle, m_bulkOutEndpoint->bEndpointAddress, txBuf, len, &txLen, m_txTimeout);
+        ASSERT_EQ(LIBUSB_SUCCESS, rc) << "Bulk Tx transfer failed (Iteration #" << iteration << ")";
+        ASSERT_EQ(len, txLen) << "Iteration #" << iteration;
+
+        rc = m_transport.bulkTransfer(m_dutHandle, m_bulkInEndpoint->bEndpointAddress, rxBuf, len, &rxLen, m_rxTimeout);
+        ASSERT_EQ(LIBUSB_SUCCESS, rc) << "Bulk Rx transfer failed (Iteration #" << iteration << ")";
+
+        latency.add(start, LatencyStatistics::Clock::now());
+
+        ASSERT_EQ(len, rxLen) << "Iteration #" << iteration;
+        ASSERT_TRUE(std::equal(txBuf, txBuf + len, rxBuf)) << "Loopback Data mismatch (Iteration #" << iteration << ")";
+    }
+
+    const double seconds = std::chrono::duration<double>(latency.total()).count();
+    const double throughput = (seconds > 0) ? ((static_cast<double>(len) * latency.count()) / seconds) : 0.0;
+
+    std::ostringstream cell;
+    cell << name(pattern) << "/offset=" << offset << "/" << name(std::get<2>(GetParam()));
+
+    std::cout << "[ Patterns ] " << cell.str() << " len=" << len
+      << " throughput=" << std::fixed << std::setprecision(2) << (throughput / 1024.0) << "KiB/s "
+      << latency << std::endl;
+
+    RecordProperty("length", len);
+    RecordProperty("throughput_Bps", static_cast<int>(throughput));
+    latency.recordProperties();
+
+    m_results[std::get<2>(GetParam())].push_back({ cell.str(), len, throughput });
+}
+
+INSTANTIATE_TEST_SUITE_P(Matrix, DataPatternTest,
+    ::testing::Combine(
+        ::testing::Values(DataPattern::Zeros, DataPattern::Ones, DataPattern::Incrementing, DataPattern::Prbs, DataPattern::Random),
+        ::testing::ValuesIn(bufferOffsets),
+        ::testing::Values(
+            TransferLength::Mod4Residue0, TransferLength::Mod4Residue1, TransferLength::Mod4Residue2,
+            TransferLength::Mod4Residue3, TransferLength::Mod8Residue4,
+            TransferLength::PacketMinusOne, TransferLength::Packet, TransferLength::PacketPlusOne,
+            TransferLength::TwoPackets)
+    ),
+    [](const ::testing::TestParamInfo<DataPatternParam> &p_info) {
+        return std::string(name(std::get<0>(p_info.param)))
+          + "_Offset" + std::to_string(std::get<1>(p_info.param))
+          + "_" + name(std::get<2>(p_info.param));
+    }
+);
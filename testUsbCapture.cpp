@@ -0,0 +1,263 @@
+/*-
+ * $Copyright$
+ */
+
+#include <libusb-1.0/libusb.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "UsbCapture.hpp"
+
+/*
+ * Round Trip of Capture Files and Configuration Descriptors. Does not need the
+ * USB Device.
+ */
+class UsbCaptureTest : public ::testing::Test {
+protected:
+    std::string m_path;
+
+    void SetUp(void) override {
+        char path[] = "/tmp/test-usbdevice-capture-XXXXXX";
+
+        int fd = ::mkstemp(path);
+        ASSERT_GE(fd, 0) << "Cannot create temporary Capture File";
+        ::close(fd);
+
+        m_path = path;
+    }
+
+    void TearDown(void) override {
+        if (!m_path.empty()) {
+            ::unlink(m_path.c_str());
+        }
+    }
+
+    /* Writes a File Header with the given Magic Number and Version */
+    void
+    writeHeader(const char (&p_magic)[8], uint32_t p_version, uint32_t p_seed) {
+        std::FILE * const file = std::fopen(m_path.c_str(), "wb");
+        ASSERT_NE(nullptr, file);
+
+        std::fwrite(p_magic, sizeof(p_magic), 1, file);
+        std::fwrite(&p_version, sizeof(p_version), 1, file);
+        std::fwrite(&p_seed, sizeof(p_seed), 1, file);
+        std::fclose(file);
+    }
+};
+
+TEST_F(UsbCaptureTest, RecordsRoundTrip) {
+    const std::vector<uint8_t> data { 0x12, 0x34, 0x56, 0x78, 0x9A };
+    UsbCapture::Record control = { UsbCapture::Call::ControlTransfer, 2, 1000, 250, { 0x80, 0x00, 0x00, 2 }, 0, nullptr };
+    UsbCapture::Record bulk = { UsbCapture::Call::BulkTransfer, LIBUSB_ERROR_TIMEOUT, 5000, 750, { 0x81, 5, 0, 0 },
+      static_cast<uint32_t>(data.size()), data.data() };
+
+    UsbCaptureWriter writer;
+    ASSERT_TRUE(writer.open(m_path, 0xC0FFEE));
+    writer.write(control);
+    writer.write(bulk);
+    writer.close();
+
+    UsbCaptureReader reader;
+    UsbCapture::Record record;
+    std::string error;
+
+    ASSERT_TRUE(reader.open(m_path, error)) << error;
+    EXPECT_EQ(0xC0FFEEu, reader.seed());
+
+    EXPECT_EQ(0u, reader.index());
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(UsbCapture::Call::ControlTransfer, record.m_call);
+    EXPECT_EQ(2, record.m_status);
+    EXPECT_EQ(1000u, record.m_offset);
+    EXPECT_EQ(250u, record.m_duration);
+    EXPECT_EQ(0x80u, record.m_args[0]);
+    EXPECT_EQ(2u, record.m_args[3]);
+    EXPECT_EQ(0u, record.m_length);
+
+    EXPECT_EQ(1u, reader.index());
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(UsbCapture::Call::BulkTransfer, record.m_call);
+    EXPECT_EQ(LIBUSB_ERROR_TIMEOUT, record.m_status);
+    EXPECT_EQ(5000u, record.m_offset);
+    EXPECT_EQ(750u, record.m_duration);
+    EXPECT_EQ(0x81u, record.m_args[0]);
+    ASSERT_EQ(data.size(), record.m_length);
+    EXPECT_EQ(data, std::vector<uint8_t>(record.m_data, record.m_data + record.m_length));
+
+    EXPECT_FALSE(reader.next(record));
+}
+
+TEST_F(UsbCaptureTest, TruncatedRecord) {
+    const std::vector<uint8_t> data(16, 0xA5);
+    UsbCapture::Record bulk = { UsbCapture::Call::BulkTransfer, 16, 0, 0, { 0x01, 16, 0, 0 },
+      static_cast<uint32_t>(data.size()), data.data() };
+
+    UsbCaptureWriter writer;
+    ASSERT_TRUE(writer.open(m_path, 0));
+    writer.write(bulk);
+    writer.write(bulk);
+    writer.close();
+
+    ASSERT_EQ(0, ::truncate(m_path.c_str(), UsbCapture::m_fileHeaderSz + 2 * (UsbCapture::m_recordHeaderSz + data.size()) - 1));
+
+    UsbCaptureReader reader;
+    UsbCapture::Record record;
+    std::string error;
+
+    ASSERT_TRUE(reader.open(m_path, error)) << error;
+    EXPECT_TRUE(reader.next(record));
+    EXPECT_FALSE(reader.next(record));
+}
+
+TEST_F(UsbCaptureTest, WriteFailureStopsRecording) {
+    const std::vector<uint8_t> data(1024, 0x5A);
+    UsbCapture::Record bulk = { UsbCapture::Call::BulkTransfer, 1024, 0, 0, { 0x01, 1024, 0, 0 },
+      static_cast<uint32_t>(data.size()), data.data() };
+
+    UsbCaptureWriter writer;
+    if (!writer.open("/dev/full", 0)) {
+        GTEST_SKIP() << "/dev/full is not available";
+    }
+
+    /* The File Header and the first Records only fill the stdio Buffer */
+    unsigned failures = 0;
+    for (unsigned idx = 0; idx < 64; idx++) {
+        if (!writer.write(bulk)) {
+            failures++;
+        }
+    }
+
+    EXPECT_EQ(1u, failures) << "Expected only the first failed Record to be reported";
+    EXPECT_FALSE(writer.error().empty());
+    EXPECT_TRUE(writer.close()) << "Capture File should already be closed";
+}
+
+TEST_F(UsbCaptureTest, RejectsBadMagic) {
+    const char magic[8] = { 'N', 'O', 'T', 'A', 'C', 'A', 'P', '\0' };
+    writeHeader(magic, UsbCapture::m_version, 0);
+
+    UsbCaptureReader reader;
+    std::string error;
+
+    EXPECT_FALSE(reader.open(m_path, error));
+    EXPECT_NE(std::string::npos, error.find("bad magic")) << error;
+}
+
+TEST_F(UsbCaptureTest, RejectsBadVersion) {
+    writeHeader(UsbCapture::m_magic, UsbCapture::m_version + 1, 0);
+
+    UsbCaptureReader reader;
+    std::string error;
+
+    EXPECT_FALSE(reader.open(m_path, error));
+    EXPECT_NE(std::string::npos, error.find("unsupported version")) << error;
+}
+
+TEST_F(UsbCaptureTest, RejectsShortFile) {
+    UsbCaptureReader reader;
+    std::string error;
+
+    /* The temporary File is still empty */
+    EXPECT_FALSE(reader.open(m_path, error));
+    EXPECT_NE(std::string::npos, error.find("too short")) << error;
+}
+
+class UsbCaptureDescriptorTest : public ::testing::Test {
+protected:
+    unsigned char                       m_configExtra[3]    = { 0x03, 0x24, 0x01 };
+    unsigned char                       m_endpointExtra[2]  = { 0x02, 0x25 };
+    struct libusb_endpoint_descriptor   m_endpoints[2];
+    struct libusb_interface_descriptor  m_altsetting;
+    struct libusb_interface             m_interface;
+    struct libusb_config_descriptor     m_config;
+
+    void SetUp(void) override {
+        ::memset(m_endpoints, 0, sizeof(m_endpoints));
+        m_endpoints[0].bLength          = LIBUSB_DT_ENDPOINT_SIZE;
+        m_endpoints[0].bDescriptorType  = LIBUSB_DT_ENDPOINT;
+        m_endpoints[0].bEndpointAddress = 0x01;
+        m_endpoints[0].bmAttributes     = LIBUSB_TRANSFER_TYPE_BULK;
+        m_endpoints[0].wMaxPacketSize   = 64;
+        m_endpoints[0].extra            = m_endpointExtra;
+        m_endpoints[0].extra_length     = sizeof(m_endpointExtra);
+        m_endpoints[1]                  = m_endpoints[0];
+        m_endpoints[1].bEndpointAddress = 0x81;
+        m_endpoints[1].extra            = nullptr;
+        m_endpoints[1].extra_length     = 0;
+
+        ::memset(&m_altsetting, 0, sizeof(m_altsetting));
+        m_altsetting.bLength            = LIBUSB_DT_INTERFACE_SIZE;
+        m_altsetting.bDescriptorType    = LIBUSB_DT_INTERFACE;
+        m_altsetting.bInterfaceNumber   = 0;
+        m_altsetting.bNumEndpoints      = 2;
+        m_altsetting.bInterfaceClass    = LIBUSB_CLASS_VENDOR_SPEC;
+        m_altsetting.endpoint           = m_endpoints;
+
+        m_interface.altsetting          = &m_altsetting;
+        m_interface.num_altsetting      = 1;
+
+        ::memset(&m_config, 0, sizeof(m_config));
+        m_config.bLength                = LIBUSB_DT_CONFIG_SIZE;
+        m_config.bDescriptorType        = LIBUSB_DT_CONFIG;
+        m_config.wTotalLength           = LIBUSB_DT_CONFIG_SIZE + LIBUSB_DT_INTERFACE_SIZE + 2 * LIBUSB_DT_ENDPOINT_SIZE;
+        m_config.bNumInterfaces         = 1;
+        m_config.bConfigurationValue    = 1;
+        m_config.bmAttributes           = 0x80;
+        m_config.MaxPower               = 50;
+        m_config.interface              = &m_interface;
+        m_config.extra                  = m_configExtra;
+        m_config.extra_length           = sizeof(m_configExtra);
+    }
+};
+
+TEST_F(UsbCaptureDescriptorTest, RoundTrip) {
+    std::vector<uint8_t> buffer;
+    UsbCapture::serializeConfigDescriptor(m_config, buffer);
+
+    struct libusb_config_descriptor * const config = UsbCapture::deserializeConfigDescriptor(buffer.data(), buffer.size());
+    ASSERT_NE(nullptr, config);
+
+    EXPECT_EQ(m_config.wTotalLength, config->wTotalLength);
+    EXPECT_EQ(m_config.bConfigurationValue, config->bConfigurationValue);
+    EXPECT_EQ(m_config.bmAttributes, config->bmAttributes);
+    EXPECT_EQ(m_config.MaxPower, config->MaxPower);
+    ASSERT_EQ(m_config.extra_length, config->extra_length);
+    EXPECT_EQ(0, ::memcmp(m_config.extra, config->extra, config->extra_length));
+
+    ASSERT_EQ(1, config->bNumInterfaces);
+    ASSERT_EQ(1, config->interface[0].num_altsetting);
+
+    const struct libusb_interface_descriptor &alt = config->interface[0].altsetting[0];
+    EXPECT_EQ(m_altsetting.bInterfaceClass, alt.bInterfaceClass);
+    EXPECT_EQ(0, alt.extra_length);
+    ASSERT_EQ(2, alt.bNumEndpoints);
+
+    for (unsigned e = 0; e < alt.bNumEndpoints; e++) {
+        EXPECT_EQ(m_endpoints[e].bEndpointAddress, alt.endpoint[e].bEndpointAddress) << "Endpoint #" << e;
+        EXPECT_EQ(m_endpoints[e].bmAttributes, alt.endpoint[e].bmAttributes) << "Endpoint #" << e;
+        EXPECT_EQ(m_endpoints[e].wMaxPacketSize, alt.endpoint[e].wMaxPacketSize) << "Endpoint #" << e;
+        ASSERT_EQ(m_endpoints[e].extra_length, alt.endpoint[e].extra_length) << "Endpoint #" << e;
+        if (alt.endpoint[e].extra_length > 0) {
+            EXPECT_EQ(0, ::memcmp(m_endpoints[e].extra, alt.endpoint[e].extra, alt.endpoint[e].extra_length)) << "Endpoint #" << e;
+        }
+    }
+
+    UsbCapture::freeConfigDescriptor(config);
+}
+
+TEST_F(UsbCaptureDescriptorTest, Truncated) {
+    std::vector<uint8_t> buffer;
+    UsbCapture::serializeConfigDescriptor(m_config, buffer);
+
+    for (size_t length = 0; length < buffer.size(); length++) {
+        EXPECT_EQ(nullptr, UsbCapture::deserializeConfigDescriptor(buffer.data(), length)) << "Length " << length;
+    }
+}